@@ -0,0 +1,57 @@
+/************************************************************************
+ *
+ * @file Allocators.h
+ *
+ * Functions whose calls create heap objects
+ *
+ ***********************************************************************/
+
+#ifndef _ALLOCATORS_H_
+#define _ALLOCATORS_H_
+
+#include <llvm/ADT/StringSet.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/Support/CommandLine.h>
+#include <string>
+
+using namespace llvm;
+
+static cl::list<std::string> ExtraAllocators("allocator",
+    cl::desc("Also treat calls of this function as allocation sites, like malloc (may be repeated)"),
+    cl::value_desc("function"), cl::CommaSeparated);
+
+///
+/// Names of the allocators: those of C and of the C++ operator new,
+/// and the ones given with -allocator. Built on first use, which is after
+/// the command line has been parsed, and only read afterwards, so the
+/// threads building CFGs can share it.
+///
+const StringSet<> &getAllocatorNames(){
+    static const StringSet<> names = []{
+        StringSet<> all;
+        for(const char* name : {"malloc", "calloc", "realloc",
+                                "_Znwm", "_Znam", "_Znwj", "_Znaj",
+                                "_ZnwmRKSt9nothrow_t", "_ZnamRKSt9nothrow_t"}){
+            all.insert(name);
+        }
+        for(const std::string &name : ExtraAllocators){
+            all.insert(name);
+        }
+        return all;
+    }();
+    return names;
+}
+
+/// The allocator @v calls, or null if @v is no allocation site. Every
+/// allocation site is one heap object, whatever the number of times it
+/// runs.
+Function* getAllocator(const Value* v){
+    const CallBase* call = dyn_cast<CallBase>(v);
+    if(!call || !call->getType()->isPointerTy()) return nullptr;
+    Function* f = dyn_cast<Function>(call->getCalledOperand()->stripPointerCasts());
+    if(!f || !getAllocatorNames().count(f->getName())) return nullptr;
+    return f;
+}
+
+#endif /* !_ALLOCATORS_H_ */
@@ -0,0 +1,314 @@
+/************************************************************************
+ *
+ * @file AnalysisCache.h
+ *
+ * On-disk cache of per-function analysis results between runs
+ *
+ ***********************************************************************/
+
+#ifndef _ANALYSISCACHE_H_
+#define _ANALYSISCACHE_H_
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+///
+/// Names that identify a value across runs on edited versions of a
+/// module: "@name" for globals and functions, "fn%aN" for the N-th
+/// argument of fn and "fn%iN" for its N-th instruction. Values without
+/// such a name (unnamed globals, constant expressions) are not cached.
+///
+class StableNames {
+    DenseMap<Value*, std::string> names;
+    StringMap<Value*> values;
+
+    static bool isPrintable(StringRef name){
+        return !name.empty() && name.find_first_of("\t\n%") == StringRef::npos;
+    }
+
+    void add(Value* v, std::string name){
+        names.insert({v, name});
+        values.insert({name, v});
+    }
+
+public:
+    void numberModule(Module &M){
+        for(GlobalVariable &gv : M.globals()){
+            if(isPrintable(gv.getName())) add(&gv, "@" + gv.getName().str());
+        }
+        for(Function &fn : M){
+            if(!isPrintable(fn.getName())) continue;
+            std::string prefix = fn.getName().str() + "%";
+            add(&fn, "@" + fn.getName().str());
+            for(Argument &arg : fn.args()){
+                add(&arg, prefix + "a" + std::to_string(arg.getArgNo()));
+            }
+            unsigned index = 0;
+            for(inst_iterator ii = inst_begin(fn), ie = inst_end(fn); ii != ie; ++ii){
+                add(&*ii, prefix + "i" + std::to_string(index++));
+            }
+        }
+    }
+
+    /// Name of @v, empty if it has none that survives edits
+    StringRef getName(Value* v) const {
+        auto it = names.find(v);
+        return it == names.end() ? StringRef() : StringRef(it->second);
+    }
+
+    /// Value called @name in this module, null if it is gone
+    Value* getValue(StringRef name) const {
+        auto it = values.find(name);
+        return it == values.end() ? nullptr : it->second;
+    }
+
+    /// Function whose body @name points into, empty for globals
+    static StringRef getOwner(StringRef name){
+        size_t sep = name.rfind('%');
+        return sep == StringRef::npos ? StringRef() : name.substr(0, sep);
+    }
+};
+
+///
+/// Fingerprint of the body of @fn: its block shape, and every
+/// instruction's opcode, type, operands by stable name and source line.
+/// It changes when the body is edited, but not when something else in
+/// the module moves.
+///
+uint64_t fingerprint(Function &fn, const StableNames &names){
+    DenseMap<BasicBlock*, unsigned> blockIndex;
+    for(BasicBlock &bb : fn){
+        blockIndex.insert({&bb, blockIndex.size()});
+    }
+
+    hash_code h = hash_value(fn.getName());
+    std::string text;
+    raw_string_ostream os(text);
+    fn.getFunctionType()->print(os);
+    for(BasicBlock &bb : fn){
+        h = hash_combine(h, blockIndex[&bb]);
+        for(Instruction &inst : bb){
+            text.clear();
+            inst.getType()->print(os);
+            os.flush();
+            h = hash_combine(h, inst.getOpcode(), text);
+            if(const DebugLoc &loc = inst.getDebugLoc()) h = hash_combine(h, loc.getLine());
+
+            for(Value* op : inst.operands()){
+                if(isa<MetadataAsValue>(op)) continue;
+                if(BasicBlock* target = dyn_cast<BasicBlock>(op)){
+                    h = hash_combine(h, blockIndex[target]);
+                    continue;
+                }
+                StringRef name = names.getName(op);
+                if(!name.empty()){
+                    h = hash_combine(h, name);
+                    continue;
+                }
+                text.clear();
+                op->print(os);
+                os.flush();
+                h = hash_combine(h, text);
+            }
+        }
+    }
+    return h;
+}
+
+///
+/// A callee summary in terms of stable names: the facts it was solved
+/// for, the facts it adds at its exit, what it returns, and the
+/// functions whose values it names ("*" if it depends on every function).
+///
+struct CachedSummary {
+    typedef std::vector<std::pair<std::string, std::vector<std::string> > > Facts;
+    Facts input;
+    Facts effects;
+    std::vector<std::string> ret;
+    std::vector<std::string> deps;
+};
+
+///
+/// Results of the previous run, stored as a tab-separated text file:
+/// the fingerprint of every function, the summaries of each callee and
+/// the final report. A summary is only handed out again if its function
+/// and every function it depends on kept their fingerprint, and the
+/// report only if the whole module did. Summaries name the objects of a
+/// caller "$0", "$1", ... by where their input reaches them, so that
+/// callers do not count among what they depend on.
+///
+class AnalysisCache {
+    std::string config;                     /// options the results depend on
+    StringMap<uint64_t> oldHashes;
+    StringMap<uint64_t> newHashes;
+    uint64_t oldGlobals = 0, newGlobals = 0;
+    bool loaded = false;
+    bool anyChanged = true;
+    std::map<std::string, std::vector<CachedSummary> > oldSummaries;
+    std::map<std::string, std::vector<CachedSummary> > newSummaries;
+    std::string oldReport;
+
+    bool isChanged(StringRef fn) const {
+        auto o = oldHashes.find(fn), n = newHashes.find(fn);
+        return o == oldHashes.end() || n == newHashes.end() || o->second != n->second;
+    }
+
+    static void writeFacts(raw_ostream &out, StringRef tag, const CachedSummary::Facts &facts){
+        for(auto &slot : facts){
+            out << tag << "\t" << slot.first;
+            for(const std::string &fact : slot.second) out << "\t" << fact;
+            out << "\n";
+        }
+    }
+
+public:
+    explicit AnalysisCache(const std::string &cfg) : config(cfg) {}
+
+    /// Fingerprint the functions and globals of @M as they are now
+    void fingerprintModule(Module &M, const StableNames &names){
+        for(Function &fn : M){
+            if(!fn.isDeclaration()) newHashes[fn.getName()] = fingerprint(fn, names);
+        }
+        hash_code h = hash_value(M.getGlobalList().size());
+        std::string text;
+        raw_string_ostream os(text);
+        for(GlobalVariable &gv : M.globals()){
+            gv.print(os);
+        }
+        for(Function &fn : M){
+            if(fn.isDeclaration()) os << fn.getName() << "\n";
+        }
+        os.flush();
+        newGlobals = hash_combine(h, text);
+    }
+
+    /// Read the results of the previous run from @path. Returns false if
+    /// there are none, or they were computed with other options.
+    bool load(StringRef path){
+        ErrorOr<std::unique_ptr<MemoryBuffer> > file = MemoryBuffer::getFile(path);
+        if(!file) return false;
+
+        SmallVector<StringRef, 0> lines;
+        (*file)->getBuffer().split(lines, '\n', -1, false);
+        if(lines.size() < 2 || lines[0] != "pointsto-cache\t3" || lines[1] != "config\t" + config)
+            return false;
+
+        CachedSummary* sum = nullptr;
+        for(StringRef line : makeArrayRef(lines).drop_front(2)){
+            SmallVector<StringRef, 8> fields;
+            line.split(fields, '\t');
+            StringRef tag = fields[0];
+            if(tag == "globals" && fields.size() == 2){
+                fields[1].getAsInteger(16, oldGlobals);
+            }
+            else if(tag == "fn" && fields.size() == 3){
+                uint64_t hash = 0;
+                fields[1].getAsInteger(16, hash);
+                oldHashes[fields[2]] = hash;
+            }
+            else if(tag == "sum" && fields.size() == 2){
+                oldSummaries[fields[1].str()].emplace_back();
+                sum = &oldSummaries[fields[1].str()].back();
+            }
+            else if(tag == "dep" && sum){
+                for(StringRef dep : makeArrayRef(fields).drop_front()) sum->deps.push_back(dep.str());
+            }
+            else if((tag == "in" || tag == "eff") && sum && fields.size() >= 2){
+                CachedSummary::Facts &facts = tag == "in" ? sum->input : sum->effects;
+                facts.emplace_back(fields[1].str(), std::vector<std::string>());
+                for(StringRef fact : makeArrayRef(fields).drop_front(2)) facts.back().second.push_back(fact.str());
+            }
+            else if(tag == "ret" && sum){
+                for(StringRef fact : makeArrayRef(fields).drop_front()) sum->ret.push_back(fact.str());
+            }
+            else if(tag == "report" && fields.size() == 2){
+                oldReport += fields[1].str() + "\n";
+            }
+        }
+
+        loaded = true;
+        anyChanged = oldGlobals != newGlobals || oldHashes.size() != newHashes.size();
+        for(auto &fn : newHashes){
+            anyChanged |= isChanged(fn.getKey());
+        }
+        return true;
+    }
+
+    /// Whether nothing the analysis reads changed since the cached run
+    bool isModuleUnchanged() const {
+        return loaded && !anyChanged;
+    }
+
+    const std::string& getReport() const {
+        return oldReport;
+    }
+
+    /// Cached summaries of @fn that are still valid
+    std::vector<const CachedSummary*> getSummaries(StringRef fn) const {
+        std::vector<const CachedSummary*> valid;
+        auto sums = oldSummaries.find(fn.str());
+        if(sums == oldSummaries.end() || isChanged(fn)) return valid;
+
+        for(const CachedSummary &sum : sums->second){
+            bool ok = true;
+            for(const std::string &dep : sum.deps){
+                ok &= dep == "*" ? !anyChanged : !isChanged(dep);
+            }
+            if(ok) valid.push_back(&sum);
+        }
+        return valid;
+    }
+
+    void addSummary(StringRef fn, CachedSummary sum){
+        newSummaries[fn.str()].push_back(std::move(sum));
+    }
+
+    /// Write the fingerprints, the summaries added since load and @report
+    bool save(StringRef path, StringRef report){
+        std::error_code ec;
+        raw_fd_ostream out(path, ec, sys::fs::OF_Text);
+        if(ec) return false;
+
+        out << "pointsto-cache\t3\n";
+        out << "config\t" << config << "\n";
+        out << "globals\t" << format_hex_no_prefix(newGlobals, 16) << "\n";
+        for(auto &fn : newHashes){
+            out << "fn\t" << format_hex_no_prefix(fn.getValue(), 16) << "\t" << fn.getKey() << "\n";
+        }
+        for(auto &sums : newSummaries){
+            for(const CachedSummary &sum : sums.second){
+                out << "sum\t" << sums.first << "\n";
+                out << "dep";
+                for(const std::string &dep : sum.deps) out << "\t" << dep;
+                out << "\n";
+                writeFacts(out, "in", sum.input);
+                writeFacts(out, "eff", sum.effects);
+                if(!sum.ret.empty()){
+                    out << "ret";
+                    for(const std::string &fact : sum.ret) out << "\t" << fact;
+                    out << "\n";
+                }
+            }
+        }
+        SmallVector<StringRef, 0> lines;
+        report.split(lines, '\n', -1, false);
+        for(StringRef line : lines){
+            out << "report\t" << line << "\n";
+        }
+        return !out.has_error();
+    }
+};
+
+#endif /* !_ANALYSISCACHE_H_ */
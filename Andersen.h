@@ -0,0 +1,471 @@
+/************************************************************************
+ *
+ * @file Andersen.h
+ *
+ * Flow-insensitive inclusion-based (Andersen) points-to engine
+ *
+ ***********************************************************************/
+
+#ifndef _ANDERSEN_H_
+#define _ANDERSEN_H_
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/ADT/DenseMap.h>
+
+#include "Point2Analysis.h"
+using namespace llvm;
+
+///
+/// Solves copy (a ⊇ b), address-of (a ⊇ {o}), load (a ⊇ *b) and store
+/// (*a ⊇ b) constraints with wave propagation: each round propagates
+/// the new part of every points-to set along the copy edges in
+/// topological order, then turns the new objects of dereferenced nodes
+/// into copy edges. Cycles are handled by
+///  - HCD: an offline pass over the constraint graph with one ref node
+///    per dereference records, for every cycle through a ref node *x,
+///    a node that the contents of every object of x get merged with;
+///  - LCD: the SCC pass that collapses cycles and recomputes the
+///    topological order only runs again after an edge between two
+///    nodes with identical points-to sets was seen.
+///
+class AndersenSolver {
+    Point2AnalysisVisitor* visitor;       /// holds the call report
+
+    std::vector<unsigned> parent;         /// union-find over nodes
+    std::vector<PtsSet> pts;              /// objects each node points to
+    std::vector<PtsSet> propagated;       /// part of pts already sent along copy edges
+    std::vector<PtsSet> resolved;         /// part of pts already applied to loads/stores/calls
+    std::vector<PtsSet> copyTo;           /// copy successors, node ids as bits
+    std::vector<std::vector<unsigned> > loadTo;      /// x -> a with a ⊇ *x
+    std::vector<std::vector<unsigned> > storeFrom;   /// x -> b with *x ⊇ b
+    std::vector<std::vector<CallInst*> > callsVia;   /// x -> calls through x
+    std::vector<int> hcdTarget;           /// x -> node *x collapses with, -1 if none
+
+    DenseMap<Value*, unsigned> valueNode;
+    DenseMap<unsigned, unsigned> contentNode;   /// object id -> node of its contents
+    DenseMap<Function*, unsigned> retNode;
+
+    std::vector<unsigned> topo;           /// propagation order
+    bool needCycleCheck = true;
+    bool changed = false;
+
+    unsigned newNode(){
+        unsigned n = parent.size();
+        parent.push_back(n);
+        pts.emplace_back();
+        propagated.emplace_back();
+        resolved.emplace_back();
+        copyTo.emplace_back();
+        loadTo.emplace_back();
+        storeFrom.emplace_back();
+        callsVia.emplace_back();
+        hcdTarget.push_back(-1);
+        topo.push_back(n);
+        return n;
+    }
+
+    unsigned find(unsigned n){
+        while(parent[n] != n){
+            parent[n] = parent[parent[n]];
+            n = parent[n];
+        }
+        return n;
+    }
+
+    unsigned getNode(Value* v){
+        // field-insensitive: constant casts and GEPs are their base pointer
+        while(ConstantExpr* ce = dyn_cast<ConstantExpr>(v)){
+            if(!ce->isCast() && ce->getOpcode() != Instruction::GetElementPtr) break;
+            v = ce->getOperand(0);
+        }
+        auto it = valueNode.find(v);
+        if(it != valueNode.end()) return find(it->second);
+
+        unsigned n = newNode();
+        valueNode.insert({v, n});
+        // functions and globals are addresses of themselves
+        if(isa<Function>(v) || isa<GlobalVariable>(v))
+            pts[n].set(objIndex.getID(v));
+        return n;
+    }
+
+    unsigned getContentNode(unsigned obj){
+        auto it = contentNode.find(obj);
+        if(it != contentNode.end()) return find(it->second);
+
+        unsigned n = newNode();
+        contentNode.insert({obj, n});
+        return n;
+    }
+
+    unsigned getRetNode(Function* f){
+        auto it = retNode.find(f);
+        if(it != retNode.end()) return find(it->second);
+
+        unsigned n = newNode();
+        retNode.insert({f, n});
+        return n;
+    }
+
+    void unite(unsigned a, unsigned b){
+        a = find(a);
+        b = find(b);
+        if(a == b) return;
+
+        parent[b] = a;
+        changed |= pts[a] |= pts[b];
+        propagated[a] &= propagated[b];
+        resolved[a] &= resolved[b];
+        copyTo[a] |= copyTo[b];
+        loadTo[a].insert(loadTo[a].end(), loadTo[b].begin(), loadTo[b].end());
+        storeFrom[a].insert(storeFrom[a].end(), storeFrom[b].begin(), storeFrom[b].end());
+        callsVia[a].insert(callsVia[a].end(), callsVia[b].begin(), callsVia[b].end());
+        if(hcdTarget[a] < 0) hcdTarget[a] = hcdTarget[b];
+
+        pts[b].clear();
+        propagated[b].clear();
+        resolved[b].clear();
+        copyTo[b].clear();
+        loadTo[b].clear();
+        storeFrom[b].clear();
+        callsVia[b].clear();
+    }
+
+    void addCopy(unsigned from, unsigned to){
+        from = find(from);
+        to = find(to);
+        if(from == to || copyTo[from].test(to)) return;
+
+        copyTo[from].set(to);
+        // lazy cycle detection: an edge between equal sets likely closes a cycle
+        if(!pts[from].empty() && pts[from] == pts[to]) needCycleCheck = true;
+        // the new edge has not seen anything from @from yet
+        changed |= pts[to] |= pts[from];
+    }
+
+    void addAddressOf(unsigned to, Value* obj){
+        changed |= pts[find(to)].test_and_set(objIndex.getID(obj));
+    }
+
+    ///
+    /// Constraint handlers, one per instruction kind
+    ///
+    void handleAllocaInst(AllocaInst* allocainst){
+        addAddressOf(getNode(allocainst), allocainst);
+    }
+
+    void handleLoadInst(LoadInst* loadinst){
+        if(!loadinst->getType()->isPointerTy()) return ;
+        // create both nodes first, a new node may move the lists
+        unsigned x = getNode(loadinst->getPointerOperand());
+        unsigned a = getNode(loadinst);
+        loadTo[x].push_back(a);
+    }
+
+    void handleStoreInst(StoreInst* storeinst){
+        Value* y = storeinst->getValueOperand();
+        if(!y->getType()->isPointerTy()) return ;
+        unsigned x = getNode(storeinst->getPointerOperand());
+        unsigned b = getNode(y);
+        storeFrom[x].push_back(b);
+    }
+
+    void handleReturnInst(ReturnInst* retinst){
+        Value* retval = retinst->getReturnValue();
+        if(!retval || !retval->getType()->isPointerTy()) return ;
+        addCopy(getNode(retval), getRetNode(retinst->getFunction()));
+    }
+
+    void handleCallInst(CallInst* callinst){
+        Value* callop = callinst->getCalledOperand()->stripPointerCasts();
+
+        if(Function* alloc = getAllocator(callinst)){
+            if(LineCallees* names = visitor->getCallOutput(callinst))
+                names->insert(alloc);
+            unsigned x = getNode(callinst);
+            addAddressOf(x, callinst);
+            // realloc and the like: *x = *arg, through a fresh node
+            if(callinst->arg_size() && callinst->getArgOperand(0)->getType()->isPointerTy()){
+                unsigned a = getNode(callinst->getArgOperand(0));
+                unsigned t = newNode();
+                loadTo[a].push_back(t);
+                storeFrom[x].push_back(t);
+            }
+            return ;
+        }
+
+        if(Function* f = dyn_cast<Function>(callop)){
+            bindCall(callinst, f);
+            return ;
+        }
+        unsigned x = getNode(callop);
+        callsVia[x].push_back(callinst);
+    }
+
+    void handleCopy(Instruction* inst){
+        if(!inst->getType()->isPointerTy()) return ;
+        unsigned to = getNode(inst);
+        for(Value* op : inst->operands()){
+            if(op->getType()->isPointerTy())
+                addCopy(getNode(op), to);
+        }
+    }
+
+    /// Wire the arguments and return value of @callinst to callee @f.
+    /// Intrinsics are no callees and move no pointers we track.
+    void bindCall(CallInst* callinst, Function* f){
+        if(f->isIntrinsic()) return ;
+        if(LineCallees* names = visitor->getCallOutput(callinst))
+            names->insert(f);
+        visitor->callGraph.addEdge(callinst, f);
+        if(f->isDeclaration()) return ;
+
+        for(unsigned i=0;i<callinst->arg_size() && i<f->arg_size();i++){
+            Value* argi = callinst->getArgOperand(i);
+            if(argi->getType()->isPointerTy())
+                addCopy(getNode(argi), getNode(f->getArg(i)));
+        }
+        if(callinst->getType()->isPointerTy())
+            addCopy(getRetNode(f), getNode(callinst));
+    }
+
+    /// Pointer constants in a global initializer are stored into the global
+    void addInitializer(unsigned content, Constant* init){
+        if(init->getType()->isPointerTy()){
+            if(!isa<ConstantPointerNull>(init) && !isa<UndefValue>(init))
+                addCopy(getNode(init), content);
+            return ;
+        }
+        for(Value* op : init->operands()){
+            if(Constant* c = dyn_cast<Constant>(op)) addInitializer(content, c);
+        }
+    }
+
+    void compConstraints(Module &M){
+        for(GlobalVariable &gv : M.globals()){
+            if(gv.hasInitializer())
+                addInitializer(getContentNode(objIndex.getID(&gv)), gv.getInitializer());
+        }
+        for(Function &fn : M){
+            for(inst_iterator ii = inst_begin(fn), ie = inst_end(fn); ii != ie; ++ii){
+                Instruction* inst = &*ii;
+                if(isa<DbgInfoIntrinsic>(inst)) continue;
+
+                if(AllocaInst* allocainst = dyn_cast<AllocaInst>(inst))
+                    handleAllocaInst(allocainst);
+                else if(LoadInst* loadinst = dyn_cast<LoadInst>(inst))
+                    handleLoadInst(loadinst);
+                else if(StoreInst* storeinst = dyn_cast<StoreInst>(inst))
+                    handleStoreInst(storeinst);
+                else if(CallInst* callinst = dyn_cast<CallInst>(inst))
+                    handleCallInst(callinst);
+                else if(ReturnInst* retinst = dyn_cast<ReturnInst>(inst))
+                    handleReturnInst(retinst);
+                else if(isa<GetElementPtrInst>(inst) || isa<CastInst>(inst) ||
+                        isa<PHINode>(inst) || isa<SelectInst>(inst))
+                    handleCopy(inst);
+            }
+        }
+    }
+
+    ///
+    /// Tarjan over the nodes [0, numNodes) of the graph given by @succs.
+    /// Calls @scc with the members of every SCC, in reverse topological
+    /// order.
+    ///
+    template<class SuccFn, class SccFn>
+    static void compSCCs(unsigned numNodes, SuccFn succs, SccFn scc){
+        std::vector<int> index(numNodes, -1), low(numNodes, 0);
+        std::vector<bool> onStack(numNodes, false);
+        std::vector<unsigned> stack, members;
+        std::vector<std::pair<unsigned, std::vector<unsigned> > > dfs;
+        int counter = 0;
+
+        for(unsigned start = 0; start < numNodes; start++){
+            if(index[start] != -1) continue;
+            dfs.push_back({start, succs(start)});
+            index[start] = low[start] = counter++;
+            stack.push_back(start);
+            onStack[start] = true;
+
+            while(!dfs.empty()){
+                unsigned n = dfs.back().first;
+                std::vector<unsigned> &next = dfs.back().second;
+                if(!next.empty()){
+                    unsigned s = next.back();
+                    next.pop_back();
+                    if(index[s] == -1){
+                        index[s] = low[s] = counter++;
+                        stack.push_back(s);
+                        onStack[s] = true;
+                        dfs.push_back({s, succs(s)});
+                    }
+                    else if(onStack[s]){
+                        low[n] = std::min(low[n], index[s]);
+                    }
+                    continue;
+                }
+
+                dfs.pop_back();
+                if(!dfs.empty())
+                    low[dfs.back().first] = std::min(low[dfs.back().first], low[n]);
+                if(low[n] != index[n]) continue;
+
+                members.clear();
+                unsigned m;
+                do {
+                    m = stack.back();
+                    stack.pop_back();
+                    onStack[m] = false;
+                    members.push_back(m);
+                } while(m != n);
+                scc(members);
+            }
+        }
+    }
+
+    /// Offline HCD: ref node of x is numNodes + x
+    void compHCD(){
+        unsigned numNodes = parent.size();
+        std::vector<std::vector<unsigned> > offline(2 * numNodes);
+        for(unsigned x = 0; x < numNodes; x++){
+            if(find(x) != x) continue;
+            for(unsigned to : copyTo[x]) offline[x].push_back(find(to));
+            for(unsigned a : loadTo[x]) offline[numNodes + x].push_back(find(a));
+            for(unsigned b : storeFrom[x]) offline[find(b)].push_back(numNodes + x);
+        }
+
+        compSCCs(2 * numNodes, [&](unsigned n) { return offline[n]; },
+            [&](const std::vector<unsigned> &members) {
+                if(members.size() < 2) return ;
+                int target = -1;
+                for(unsigned m : members){
+                    if(m >= numNodes) continue;
+                    if(target < 0) target = m;
+                    else unite(target, m);
+                }
+                if(target < 0) return ;
+                for(unsigned m : members){
+                    if(m >= numNodes) hcdTarget[find(m - numNodes)] = target;
+                }
+            });
+    }
+
+    /// Collapse the cycles of the copy graph and recompute the topological order
+    void collapseCycles(){
+        std::vector<std::vector<unsigned> > sccs;
+        compSCCs(parent.size(),
+            [&](unsigned n) {
+                std::vector<unsigned> next;
+                if(find(n) != n) return next;
+                for(unsigned to : copyTo[n]){
+                    unsigned rep = find(to);
+                    if(rep != n) next.push_back(rep);
+                }
+                return next;
+            },
+            [&](const std::vector<unsigned> &members) { sccs.push_back(members); });
+
+        topo.clear();
+        for(auto it = sccs.rbegin(); it != sccs.rend(); ++it){
+            unsigned first = it->front();
+            // merged-away nodes show up as singletons
+            if(it->size() == 1 && find(first) != first) continue;
+            for(unsigned m : *it) unite(first, m);
+            topo.push_back(find(first));
+        }
+        needCycleCheck = false;
+    }
+
+    void propagate(){
+        for(unsigned i = 0; i < topo.size(); i++){
+            unsigned n = topo[i];
+            if(find(n) != n) continue;
+
+            PtsSet delta = pts[n];
+            delta.intersectWithComplement(propagated[n]);
+            if(delta.empty()) continue;
+            propagated[n] = pts[n];
+
+            for(unsigned to : copyTo[n]){
+                unsigned rep = find(to);
+                if(rep == n) continue;
+                if(pts[rep] == pts[n]) needCycleCheck = true;
+                changed |= pts[rep] |= delta;
+            }
+        }
+    }
+
+    void resolveComplex(){
+        for(unsigned x = 0; x < parent.size(); x++){
+            if(find(x) != x) continue;
+            if(loadTo[x].empty() && storeFrom[x].empty() && callsVia[x].empty()) continue;
+
+            PtsSet delta = pts[x];
+            delta.intersectWithComplement(resolved[x]);
+            if(delta.empty()) continue;
+            resolved[x] = pts[x];
+
+            for(unsigned obj : delta){
+                unsigned content = getContentNode(obj);
+                if(hcdTarget[x] >= 0) unite(hcdTarget[x], content);
+
+                // copy the lists, new edges may merge x away
+                std::vector<unsigned> loads = loadTo[find(x)];
+                std::vector<unsigned> stores = storeFrom[find(x)];
+                std::vector<CallInst*> calls = callsVia[find(x)];
+                for(unsigned a : loads) addCopy(getContentNode(obj), a);
+                for(unsigned b : stores) addCopy(b, getContentNode(obj));
+                if(Function* f = dyn_cast<Function>(objIndex.getObject(obj))){
+                    for(CallInst* callinst : calls) bindCall(callinst, f);
+                }
+            }
+        }
+    }
+
+public:
+    AndersenSolver(Point2AnalysisVisitor* v) : visitor(v) {}
+
+    void solve(Module &M){
+        StatsPhase phase(AnalysisStats::Inclusion);
+        compConstraints(M);
+        compHCD();
+
+        do {
+            changed = false;
+            if(needCycleCheck) collapseCycles();
+            propagate();
+            resolveComplex();
+        } while(changed);
+    }
+};
+
+class AndersenAnalysis : public ModulePass {
+public:
+
+    static char ID;
+    raw_ostream &out;     /// where the result goes
+    AndersenAnalysis() : ModulePass(ID), out(errs()) {}
+    explicit AndersenAnalysis(raw_ostream &o) : ModulePass(ID), out(o) {}
+
+    bool runOnModule(Module &M) override {
+        objIndex.clear();
+        objIndex.numberModule(M);
+
+        Point2AnalysisVisitor visitor;
+        AndersenSolver solver(&visitor);
+        solver.solve(M);
+        visitor.printResult(out);
+        visitor.callGraph.write(M);
+
+        objIndex.clear();
+        ptsTable.clear();
+        return false;
+    }
+};
+
+#endif /* !_ANDERSEN_H_ */
@@ -0,0 +1,304 @@
+/************************************************************************
+ *
+ * @file CallGraph.h
+ *
+ * Call graph of direct and resolved indirect calls, its strongly
+ * connected components, and its export as DOT or JSON
+ *
+ ***********************************************************************/
+
+#ifndef _CALLGRAPH_H_
+#define _CALLGRAPH_H_
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+enum CallGraphFormat { CallGraphDOT, CallGraphJSON };
+
+static cl::opt<std::string> CallGraphFile("callgraph",
+    cl::desc("Write the call graph, with the indirect calls resolved by the analysis, to this file"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<CallGraphFormat> CallGraphFormatOpt("callgraph-format",
+    cl::desc("Format of -callgraph"),
+    cl::values(clEnumValN(CallGraphDOT, "dot", "Graphviz (default)"),
+               clEnumValN(CallGraphJSON, "json", "nodes, edges and SCCs as JSON")),
+    cl::init(CallGraphDOT));
+
+///
+/// Which functions each call may call. Direct calls are added from the
+/// IR, indirect ones as the analysis resolves them; an edge is kept once
+/// per call site and callee. Nodes are numbered in the order they are
+/// added, which keeps the output stable from run to run.
+///
+class CallGraph {
+public:
+    struct Edge {
+        CallInst* site;
+        Function* callee;
+        bool indirect;
+    };
+
+private:
+    std::vector<Function*> nodes;
+    DenseMap<Function*, unsigned> nodeIDs;
+    std::vector<std::vector<Edge> > edges;      /// caller node -> its calls
+    DenseSet<std::pair<CallInst*, Function*> > known;
+
+    std::vector<std::vector<unsigned> > sccs;   /// bottom-up
+    std::vector<unsigned> sccOf;                /// node -> scc
+    bool sccsValid = false;
+
+    ///
+    /// Tarjan's algorithm, iterative so that long call chains cannot
+    /// overflow the stack. SCCs come out callees first.
+    ///
+    void compSCCs(){
+        unsigned n = nodes.size();
+        std::vector<unsigned> index(n, UINT_MAX), low(n, 0);
+        std::vector<bool> onStack(n, false);
+        std::vector<unsigned> stack;
+        std::vector<std::pair<unsigned, unsigned> > frames;   /// node, next edge
+        unsigned next = 0;
+
+        sccs.clear();
+        sccOf.assign(n, 0);
+        for(unsigned root=0;root<n;root++){
+            if(index[root] != UINT_MAX) continue;
+            frames.push_back({root, 0});
+            index[root] = low[root] = next++;
+            stack.push_back(root);
+            onStack[root] = true;
+
+            while(!frames.empty()){
+                unsigned v = frames.back().first;
+                unsigned &e = frames.back().second;
+                if(e < edges[v].size()){
+                    unsigned w = nodeIDs[edges[v][e++].callee];
+                    if(index[w] == UINT_MAX){
+                        index[w] = low[w] = next++;
+                        stack.push_back(w);
+                        onStack[w] = true;
+                        frames.push_back({w, 0});
+                    }
+                    else if(onStack[w]){
+                        low[v] = std::min(low[v], index[w]);
+                    }
+                    continue;
+                }
+
+                frames.pop_back();
+                if(!frames.empty()){
+                    unsigned u = frames.back().first;
+                    low[u] = std::min(low[u], low[v]);
+                }
+                if(low[v] != index[v]) continue;
+
+                std::vector<unsigned> scc;
+                unsigned w;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    onStack[w] = false;
+                    sccOf[w] = sccs.size();
+                    scc.push_back(w);
+                } while(w != v);
+                std::sort(scc.begin(), scc.end());
+                sccs.push_back(std::move(scc));
+            }
+        }
+        sccsValid = true;
+    }
+
+public:
+    unsigned addFunction(Function* f){
+        auto it = nodeIDs.find(f);
+        if(it != nodeIDs.end()) return it->second;
+
+        unsigned id = nodes.size();
+        nodeIDs.insert({f, id});
+        nodes.push_back(f);
+        edges.emplace_back();
+        sccsValid = false;
+        return id;
+    }
+
+    /// Record that @site may call @callee, false if that was known
+    bool addEdge(CallInst* site, Function* callee){
+        if(!known.insert({site, callee}).second) return false;
+        unsigned caller = addFunction(site->getFunction());
+        addFunction(callee);
+        bool indirect = site->getCalledOperand()->stripPointerCasts() != callee;
+        edges[caller].push_back({site, callee, indirect});
+        sccsValid = false;
+        return true;
+    }
+
+    /// Add every function of @M and the calls that name their callee
+    void addDirectCalls(Module &M){
+        for(Function &fn : M){
+            if(fn.isIntrinsic()) continue;
+            addFunction(&fn);
+            for(inst_iterator ii = inst_begin(fn), ie = inst_end(fn); ii != ie; ++ii){
+                CallInst* callinst = dyn_cast<CallInst>(&*ii);
+                if(!callinst || isa<IntrinsicInst>(callinst)) continue;
+                if(Function* f = dyn_cast<Function>(callinst->getCalledOperand()->stripPointerCasts()))
+                    addEdge(callinst, f);
+            }
+        }
+    }
+
+    /// Number of (call site, callee) edges
+    unsigned getNumCalls() const {
+        return known.size();
+    }
+
+    ArrayRef<Function*> getFunctions() const {
+        return nodes;
+    }
+
+    /// The calls made by @f
+    ArrayRef<Edge> getCalls(Function* f) const {
+        auto it = nodeIDs.find(f);
+        if(it == nodeIDs.end()) return ArrayRef<Edge>();
+        return edges[it->second];
+    }
+
+    /// Strongly connected components as indices into getFunctions(), each
+    /// callee's before its callers'
+    const std::vector<std::vector<unsigned> >& getSCCs(){
+        if(!sccsValid) compSCCs();
+        return sccs;
+    }
+
+    /// Whether the component @scc of getSCCs() is a cycle: several
+    /// functions, or one that calls itself
+    bool isCycle(const std::vector<unsigned> &scc) const {
+        if(scc.size() > 1) return true;
+        Function* f = nodes[scc[0]];
+        return std::any_of(edges[scc[0]].begin(), edges[scc[0]].end(),
+                           [&](const Edge &edge){ return edge.callee == f; });
+    }
+
+    /// Whether @f is in a cycle of the graph, so that a call of it may
+    /// enter it again before it returns
+    bool isInCycle(Function* f){
+        auto it = nodeIDs.find(f);
+        if(it == nodeIDs.end()) return false;
+        const std::vector<std::vector<unsigned> > &components = getSCCs();
+        return isCycle(components[sccOf[it->second]]);
+    }
+
+    ///
+    /// Graphviz: one node per function, dashed edges for resolved
+    /// indirect calls labeled with their line, and a box around every
+    /// cycle
+    ///
+    void writeDOT(raw_ostream &out){
+        out << "digraph callgraph {\n";
+        out << "  node [shape=box];\n";
+        const std::vector<std::vector<unsigned> > &components = getSCCs();
+        for(unsigned i=0;i<components.size();i++){
+            const std::vector<unsigned> &scc = components[i];
+            bool cycle = isCycle(scc);
+            if(cycle) out << "  subgraph cluster_" << i << " {\n    style=dashed;\n";
+            for(unsigned node : scc){
+                out << (cycle ? "    " : "  ") << "n" << node << " [label=\"";
+                printEscapedString(nodes[node]->getName(), out);
+                out << "\"" << (nodes[node]->isDeclaration() ? ", style=dotted" : "") << "];\n";
+            }
+            if(cycle) out << "  }\n";
+        }
+        for(unsigned caller=0;caller<nodes.size();caller++){
+            for(const Edge &edge : edges[caller]){
+                out << "  n" << caller << " -> n" << nodeIDs[edge.callee];
+                if(edge.indirect){
+                    out << " [style=dashed, label=\"" << edge.site->getDebugLoc().getLine() << "\"]";
+                }
+                out << ";\n";
+            }
+        }
+        out << "}\n";
+    }
+
+    ///
+    /// {"functions": [{"name", "declaration", "scc"}],
+    ///  "calls": [{"caller", "callee", "line", "indirect"}],
+    ///  "sccs": [[function index]]}, SCCs callees first
+    ///
+    void writeJSON(raw_ostream &out){
+        const std::vector<std::vector<unsigned> > &components = getSCCs();
+        json::OStream os(out, 2);
+        os.object([&]{
+            os.attributeArray("functions", [&]{
+                for(unsigned node=0;node<nodes.size();node++){
+                    os.object([&]{
+                        os.attribute("name", nodes[node]->getName());
+                        os.attribute("declaration", nodes[node]->isDeclaration());
+                        os.attribute("scc", (int64_t)sccOf[node]);
+                    });
+                }
+            });
+            os.attributeArray("calls", [&]{
+                for(unsigned caller=0;caller<nodes.size();caller++){
+                    for(const Edge &edge : edges[caller]){
+                        os.object([&]{
+                            os.attribute("caller", (int64_t)caller);
+                            os.attribute("callee", (int64_t)nodeIDs[edge.callee]);
+                            os.attribute("line", (int64_t)edge.site->getDebugLoc().getLine());
+                            os.attribute("indirect", edge.indirect);
+                        });
+                    }
+                }
+            });
+            os.attributeArray("sccs", [&]{
+                for(const std::vector<unsigned> &scc : components){
+                    os.array([&]{
+                        for(unsigned node : scc) os.value((int64_t)node);
+                    });
+                }
+            });
+        });
+        out << "\n";
+    }
+
+    /// Add the direct calls of @M and write the graph to -callgraph, if given
+    bool write(Module &M){
+        if(CallGraphFile.empty()) return true;
+        addDirectCalls(M);
+
+        std::error_code ec;
+        raw_fd_ostream file(CallGraphFile, ec, sys::fs::OF_Text);
+        if(ec){
+            errs() << "warning: could not write call graph " << CallGraphFile << ": " << ec.message() << "\n";
+            return false;
+        }
+        if(CallGraphFormatOpt == CallGraphJSON) writeJSON(file);
+        else writeDOT(file);
+        file.close();
+        if(!file.has_error()) return true;
+        errs() << "warning: could not write call graph " << CallGraphFile << "\n";
+        file.clear_error();
+        return false;
+    }
+};
+
+#endif /* !_CALLGRAPH_H_ */
@@ -0,0 +1,100 @@
+/************************************************************************
+ *
+ * @file CallTable.h
+ *
+ * The reported calls of each source line, kept as object ids
+ *
+ ***********************************************************************/
+
+#ifndef _CALLTABLE_H_
+#define _CALLTABLE_H_
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <map>
+
+#include "PointsToSet.h"
+
+using namespace llvm;
+
+///
+/// What the calls on one source line may call, as sorted object ids.
+/// Adding a callee that is already there only costs a binary search.
+///
+class LineCallees {
+    SmallVector<unsigned, 2> ids;
+
+public:
+    /// Add the object @id, false if it was there already
+    bool insert(unsigned id){
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if(it != ids.end() && *it == id) return false;
+        ids.insert(it, id);
+        return true;
+    }
+
+    bool insert(Value* callee){
+        return insert(objIndex.getID(callee));
+    }
+
+    unsigned size() const {
+        return ids.size();
+    }
+
+    /// Names of the callees in the order they are printed
+    void getNames(SmallVectorImpl<StringRef> &names) const {
+        for(unsigned id : ids) names.push_back(objIndex.getObject(id)->getName());
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+    }
+};
+
+///
+/// The reported calls by source line. Callees only become names when the
+/// table is printed, which has to happen before objIndex is cleared.
+///
+class CallTable {
+    std::map<unsigned, LineCallees> lines;    /// nodes stay put while calls are handled
+
+public:
+    LineCallees* getLine(unsigned line){
+        return &lines[line];
+    }
+
+    /// Call @fn with each line and the names of its callees, by line
+    void forEachLine(function_ref<void(unsigned, ArrayRef<StringRef>)> fn) const {
+        SmallVector<StringRef, 8> names;
+        for(auto &line : lines){
+            names.clear();
+            line.second.getNames(names);
+            fn(line.first, names);
+        }
+    }
+
+    /// Print "line:callee,callee" per line. The text is gathered in a
+    /// buffer and written in large pieces, as @out may be unbuffered.
+    void print(raw_ostream &out) const {
+        SmallString<4096> buf;
+        raw_svector_ostream os(buf);
+        forEachLine([&](unsigned line, ArrayRef<StringRef> names){
+            os << line << ":";
+            for(unsigned i=0;i<names.size();i++){
+                if(i) os << ",";
+                os << names[i];
+            }
+            os << "\n";
+            if(buf.size() >= 4096){
+                out << buf;
+                buf.clear();
+            }
+        });
+        out << buf;
+    }
+};
+
+#endif /* !_CALLTABLE_H_ */
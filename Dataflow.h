@@ -10,15 +10,36 @@
 #define _DATAFLOW_H_
 
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Allocator.h>
 #include <map>
+#include <memory>
+#include <vector>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+
+#include "Allocators.h"
+#include "Scheduler.h"
+#include "Stats.h"
+#include "Trace.h"
 
 using namespace llvm;
 
 class myBasicBlock;
 class myFunc{
+    /// Owns every block of this function. Most functions have a handful of
+    /// blocks, so slabs are kept small.
+    BumpPtrAllocatorImpl<MallocAllocator, 1024> blockPool;
+
 public:
     Function* mf;
     std::set<myBasicBlock*> mbSet;
@@ -26,10 +47,15 @@ public:
     myBasicBlock* exit_block;
 
     myFunc(Function* f): mf(f), mbSet(){}
+    ~myFunc();
     
     void addmyBasicBlock(myBasicBlock* mb){
         mbSet.insert(mb);
     } 
+
+    /// New block of this function covering (part of) @bb, freed together
+    /// with the function
+    myBasicBlock* createBlock(BasicBlock* bb);
     
     void setEntryBlock(myBasicBlock* mb){
         entry_block = mb;
@@ -55,27 +81,29 @@ public:
     BasicBlock* bb;
     BasicBlock::iterator begin_inst;
     BasicBlock::iterator end_inst;
-    std::set<myBasicBlock*> mSuccs;
-    std::set<myBasicBlock*> mPreds;
+    /// Edges are kept in flat arrays in insertion order, without
+    /// duplicates, and succ is in mSuccs iff this is in succ->mPreds
+    SmallVector<myBasicBlock*, 2> mSuccs;
+    SmallVector<myBasicBlock*, 2> mPreds;
     bool isExitBlock = 0; 
 
     myBasicBlock(BasicBlock* initb, myFunc* mf): bb(initb),parent(mf), mSuccs(), mPreds(){} 
 
     void addSucc(myBasicBlock* succ){
-        this->mSuccs.insert(succ);
-        succ->mPreds.insert(this);
+        if(is_contained(mSuccs, succ)) return;
+        this->mSuccs.push_back(succ);
+        succ->mPreds.push_back(this);
     }  
     
     void addPred(myBasicBlock* pred ){
-        this->mPreds.insert(pred);
-        pred->mSuccs.insert(this);
+        pred->addSucc(this);
     }
     
-    std::set<myBasicBlock*> getSuccs(){
+    ArrayRef<myBasicBlock*> getSuccs() const {
         return mSuccs;
     }
 
-    std::set<myBasicBlock*> getPreds(){
+    ArrayRef<myBasicBlock*> getPreds() const {
         return mPreds;
     }
 
@@ -95,13 +123,22 @@ public:
         return end_inst;
     }
 
+    void print(raw_ostream &out){
+        out << bb->getName() << ":\n";
+        for(BasicBlock::iterator ii = begin_inst; ii != end_inst; ++ii){
+            out << *ii << "\n";
+        }
+    }
+
     myBasicBlock* split(BasicBlock::iterator ii){
-        myBasicBlock* newMbb = new myBasicBlock(bb,parent);
-        parent->mbSet.insert(newMbb);
+        myBasicBlock* newMbb = parent->createBlock(bb);
 
-	for(myBasicBlock* suci:this->getSuccs()){
-	    newMbb->addSucc(suci);
-	}
+        // the successors now follow the second half, so it replaces this
+        // block among their predecessors
+        for(myBasicBlock* suci:this->getSuccs()){
+            std::replace(suci->mPreds.begin(), suci->mPreds.end(), this, newMbb);
+            newMbb->mSuccs.push_back(suci);
+        }
         this->mSuccs.clear();
         this->addSucc(newMbb);
 
@@ -119,9 +156,311 @@ public:
     }
 };
 
+myFunc::~myFunc(){
+    // every block is in mbSet, the pool only frees the memory
+    for(myBasicBlock* mbb : mbSet){
+        mbb->~myBasicBlock();
+    }
+}
+
+myBasicBlock* myFunc::createBlock(BasicBlock* bb){
+    myBasicBlock* mbb = new (blockPool.Allocate<myBasicBlock>()) myBasicBlock(bb, this);
+    mbSet.insert(mbb);
+    return mbb;
+}
+
+/// Name of @mbb on the timeline: its function and block, and the first
+/// instruction if a call split the block
+StringRef getTraceLabel(myBasicBlock* mbb){
+    std::string &label = traceBuffer.labels[mbb];
+    if(!label.empty()) return label;
+
+    BasicBlock* bb = mbb->bb;
+    raw_string_ostream os(label);
+    os << bb->getParent()->getName() << ":";
+    if(bb->hasName()){
+        os << bb->getName();
+    }
+    else{
+        os << "bb" << std::distance(bb->getParent()->begin(), bb->getIterator());
+    }
+    if(mbb->begin_inst != bb->begin()){
+        os << "+" << std::distance(bb->begin(), mbb->begin_inst);
+    }
+    return os.str();
+}
+
+static cl::opt<bool> ShowVisits("show-visits",
+    cl::desc("Print the number of block visits of each dataflow solve"),
+    cl::init(false));
+
+///
+/// Worklist of blocks, popped in reverse post-order of the CFG reachable
+/// from the root block (post-order for backward problems). Membership is
+/// a bitset over order positions, and pops sweep it in passes, so the
+/// next block is the next set bit after the one visited last.
+///
+class Worklist {
+    bool forward;
+    myBasicBlock* root = nullptr;
+    std::vector<myBasicBlock*> order;             /// RPO position -> block
+    DenseMap<myBasicBlock*, unsigned> position;   /// block -> RPO position
+    BitVector pending;
+    unsigned cursor = 0;                          /// RPO position after the last pop
+    myBasicBlock* lastPopped = nullptr;
+    bool stale = false;
+    unsigned long visits = 0;
+
+    unsigned append(myBasicBlock* mbb){
+        unsigned pos = order.size();
+        order.push_back(mbb);
+        position.insert({mbb, pos});
+        pending.resize(order.size());
+        return pos;
+    }
+
+    /// Number every block reachable from root in solving order, keeping
+    /// pending blocks pending
+    void computeOrder(){
+        std::vector<myBasicBlock*> waiting;
+        for(int i = pending.find_first(); i != -1; i = pending.find_next(i)){
+            waiting.push_back(order[i]);
+        }
+
+        std::vector<myBasicBlock*> postorder;
+        DenseSet<myBasicBlock*> visited;
+        std::vector<std::pair<myBasicBlock*, ArrayRef<myBasicBlock*>::iterator> > stack;
+        if(root){
+            visited.insert(root);
+            stack.push_back({root, root->mSuccs.begin()});
+        }
+        while(!stack.empty()){
+            myBasicBlock* mbb = stack.back().first;
+            if(stack.back().second == mbb->mSuccs.end()){
+                postorder.push_back(mbb);
+                stack.pop_back();
+                continue;
+            }
+            myBasicBlock* succ = *stack.back().second++;
+            if(visited.insert(succ).second){
+                stack.push_back({succ, succ->mSuccs.begin()});
+            }
+        }
+
+        order.clear();
+        position.clear();
+        pending.clear();
+        if(forward){
+            for(auto it = postorder.rbegin(); it != postorder.rend(); ++it){
+                append(*it);
+            }
+        }
+        else{
+            for(myBasicBlock* mbb : postorder){
+                append(mbb);
+            }
+        }
+        for(myBasicBlock* mbb : waiting){
+            push(mbb);
+        }
+        // resume the current pass right after the block visited last
+        auto last = position.find(lastPopped);
+        cursor = last == position.end() ? 0 : last->second + 1;
+        stale = false;
+    }
+
+public:
+    Worklist(bool isforward = true) : forward(isforward) {}
+
+    void setRoot(myBasicBlock* mbb){
+        root = mbb;
+        computeOrder();
+    }
+
+    /// The CFG changed shape, renumber before the next pop
+    void invalidateOrder(){
+        stale = true;
+    }
+
+    void push(myBasicBlock* mbb){
+        stats.worklistPushes++;
+        auto it = position.find(mbb);
+        // blocks not reachable from root yet go after everything else
+        unsigned pos = it == position.end() ? append(mbb) : it->second;
+        pending.set(pos);
+    }
+
+    myBasicBlock* pop(){
+        if(stale) computeOrder();
+        // sweep forward from the last popped block, wrapping around when
+        // the end of the order is reached, i.e. iterate in RPO passes
+        int pos = pending.find_first_in(cursor, pending.size());
+        if(pos == -1) pos = pending.find_first();
+        pending.reset(pos);
+        cursor = pos + 1;
+        lastPopped = order[pos];
+        visits++;
+        stats.worklistPops++;
+        return order[pos];
+    }
+
+    bool empty() const {
+        return pending.none();
+    }
+
+    unsigned long getNumVisits() const {
+        return visits;
+    }
+};
+
+///
+/// Build the blocks of the myFunc CFG @mf. Every call instruction (except
+/// allocation sites) ends the block it belongs to, the instructions after it
+/// start a new block. Only reads the IR of its function and only
+/// allocates from its own pool, so CFGs of different functions can be
+/// built concurrently.
+///
+void buildBlocks(myFunc* mf){
+    Function &fn = *mf->mf;
+
+    BasicBlock* begin_block =  &(fn.getEntryBlock());
+    myBasicBlock* begin_mbb = mf->createBlock(begin_block);
+    begin_mbb->setBeginInst(begin_block->begin());
+    begin_mbb->setEndInst(begin_block->end());
+    
+    mf->setEntryBlock(begin_mbb); 
+    
+    std::map<BasicBlock*,myBasicBlock*> createdList;
+    std::set<BasicBlock*> blist;
+    createdList.insert({begin_block,begin_mbb});
+    blist.insert(begin_block); 
+     
+
+    while(!blist.empty()){
+        BasicBlock* block = *blist.begin();
+        blist.erase(blist.begin());
+        myBasicBlock* pre_mbb = createdList[block];
+
+        for(auto si = succ_begin(block), se = succ_end(block); si!=se; si++){
+            BasicBlock* succb = *si;
+            myBasicBlock* succ_mbb;  
+
+            if(createdList.find(succb)==createdList.end()){
+                succ_mbb = mf->createBlock(succb);
+                succ_mbb->setBeginInst(succb->begin());
+                succ_mbb->setEndInst(succb->end());
+                
+                createdList.insert({succb,succ_mbb});
+                blist.insert(succb);                         
+            }
+            else{
+                succ_mbb = createdList[succb];
+            }
+            
+            pre_mbb->addSucc(succ_mbb); 
+            
+        }                
+    }
+
+    mf->setExitBlock(createdList[&(fn.back())]);
+    mf->getExitBlock()->isExitBlock = 1;
+    for(Function::iterator bi = fn.begin(), be = fn.end();bi != be; bi++){
+        BasicBlock* bb = &*bi;
+        
+        for (BasicBlock::iterator ii=bb->begin(), ie=bb->end(); ii!=ie; ++ii){
+            Instruction* inst = &*ii;
+            if(isa<DbgInfoIntrinsic>(inst)) continue; 
+            if(CallInst* callinst = dyn_cast<CallInst>(inst)){
+                if(!getAllocator(callinst)){
+                    myBasicBlock* mbb = createdList[bb];
+                    auto tmpi = ii;
+                    tmpi++;
+                    createdList[bb] =  mbb->split(tmpi);
+                } 
+            }
+        }
+    } 
+
+}
+
+///
+/// State of one analysis run: the myFunc CFGs it built, which its solver
+/// may splice together, and the worklist of its dataflow solves. A CFG is
+/// only built once the solver reaches its function, so the cost follows
+/// the reachable program. The CFGs live in pools owned by the context and
+/// are all released with it.
+///
+/// Reaching a function also builds the CFGs of the functions it reaches
+/// through direct calls, which the solver visits next, one job per
+/// function on a work-stealing pool of @threads threads. The pool keeps
+/// its threads for the whole run, for these and every other batch of
+/// jobs the run hands to getPool().
+///
+class AnalysisContext {
+    SpecificBumpPtrAllocator<myFunc> funcPool;
+    std::unique_ptr<WorkStealingPool> pool;
+
+    myFunc* createMyFunc(Function* fn){
+        return new (funcPool.Allocate()) myFunc(fn);
+    }
+
+    myFunc* addMyFunc(Function* fn){
+        myFunc* mf = createMyFunc(fn);
+        func2myfunc.insert({fn, mf});
+        return mf;
+    }
 
-std::set<myBasicBlock*> worklist;
-extern std::map<Function*, myFunc*> func2myfunc;
+public:
+    std::map<Function*, myFunc*> func2myfunc;
+    Worklist worklist;
+    unsigned threads = 1;
+
+    AnalysisContext() {}
+    AnalysisContext(const AnalysisContext &) = delete;
+    AnalysisContext& operator=(const AnalysisContext &) = delete;
+
+    /// Pool of @threads threads, started on first use
+    WorkStealingPool& getPool(){
+        if(!pool || pool->size() != std::max(threads, 1u))
+            pool = std::make_unique<WorkStealingPool>(threads);
+        return *pool;
+    }
+
+    myFunc* getMyFunc(Function* fn){
+        auto built = func2myfunc.find(fn);
+        return built == func2myfunc.end() ? nullptr : built->second;
+    }
+
+    /// CFG of @fn, built on first request along with those of the
+    /// functions it directly calls, transitively, that are not built yet,
+    /// unless @callees is false
+    myFunc* buildMyFunc(Function &fn, bool callees = true){
+        if(myFunc* mf = getMyFunc(&fn)) return mf;
+
+        // the pool is not thread-safe, so the functions are allocated here
+        // and only their blocks in the jobs
+        std::vector<myFunc*> missing{addMyFunc(&fn)};
+        for(size_t i=0;callees && i<missing.size();i++){
+            for(inst_iterator ii = inst_begin(missing[i]->mf), ie = inst_end(missing[i]->mf); ii != ie; ++ii){
+                CallInst* callinst = dyn_cast<CallInst>(&*ii);
+                if(!callinst) continue;
+                Function* callee = dyn_cast<Function>(callinst->getCalledOperand()->stripPointerCasts());
+                if(!callee || callee->isDeclaration() || getMyFunc(callee)) continue;
+                missing.push_back(addMyFunc(callee));
+            }
+        }
+
+        StatsPhase phase(AnalysisStats::PreProcess);
+        getPool().forEach(missing.size(), [&](size_t i){
+            TraceJob events;
+            buildBlocks(missing[i]);
+        });
+        // counted here, the jobs may run on threads whose stats are dropped
+        stats.cfgFunctions += missing.size();
+        for(myFunc* mf : missing) stats.cfgBlocks += mf->mbSet.size();
+        return missing[0];
+    }
+};
 
 ///Base dataflow visitor class, defines the dataflow function
 template <class T>
@@ -135,7 +474,6 @@ public:
     /// @dfval the input dataflow value
     /// @isforward true to compute dfval forward, otherwise backward
     virtual void compDFVal(myBasicBlock *mblock, T *dfval, bool isforward) {
-        BasicBlock* block = mblock->bb;
         if (isforward == true) {
            for (BasicBlock::iterator ii=mblock->getBeginInst(), ie=mblock->getEndInst(); 
                 ii!=ie; ++ii) {
@@ -143,8 +481,9 @@ public:
                 compDFVal(inst, dfval,mblock);
            }
         } else {
-           for (BasicBlock::reverse_iterator ii=block->rbegin(), ie=block->rend();
-                ii != ie; ++ii) {
+           for (BasicBlock::iterator ii=mblock->getEndInst(), ib=mblock->getBeginInst();
+                ii != ib; ) {
+                --ii;
                 Instruction * inst = &*ii;
                 compDFVal(inst, dfval,mblock);
            }
@@ -163,6 +502,12 @@ public:
     /// @return true if dest changed
     ///
     virtual void merge( T *dest, const T &src ) = 0;
+    ///
+    /// Number of facts in @dfval, plotted on -trace-events timelines
+    ///
+    virtual unsigned getStateSize(const T &) {
+        return 0;
+    }
 };
 
 ///
@@ -174,73 +519,153 @@ struct DataflowResult {
     typedef typename std::map<myBasicBlock *, std::pair<T, T> > Type;
 };
 
-/// 
-/// Compute a forward iterated fixedpoint dataflow function, using a user-supplied
-/// visitor function. Note that the caller must ensure that the function is
-/// in fact a monotone function, as otherwise the fixedpoint may not terminate.
-/// 
-/// @param fn The function
-/// @param visitor A function to compute dataflow vals
-/// @param result The results of the dataflow 
-/// @initval the Initial dataflow value
+///
+/// Forward fixedpoint over the CFG @mfn, popping blocks from @worklist. A
+/// visitor can run a nested solve from inside a transfer function by
+/// passing its own worklist.
+///
 template<class T>
-void compForwardDataflow(Function *fn,
+void compForwardDataflow(myFunc *mfn,
+    Worklist &worklist,
     DataflowVisitor<T> *visitor,
     typename DataflowResult<T>::Type *result,
     const T & initval) {
 
-    myFunc* mfn = func2myfunc[fn];     
-    
+    worklist.setRoot(mfn->getEntryBlock());
     for(myBasicBlock* mbb: mfn->mbSet){
         result->insert(std::make_pair(mbb,std::make_pair(initval, initval)));
-        worklist.insert(mbb);
+        worklist.push(mbb);
     }
 
     while(!worklist.empty()) {
-        myBasicBlock * mbb = *worklist.begin();
-        worklist.erase(worklist.begin());
+        myBasicBlock * mbb = worklist.pop();
 
-        if(result->find(mbb) == result->end()){
-            result->insert(std::make_pair(mbb,std::make_pair(initval, initval)));
+        TraceSpan span("visit");
+        if(span.enabled()){
+            span.setName(getTraceLabel(mbb));
+            span.arg("visit", traceVisit(mbb));
         }
 
-        T bbentryval = (*result)[mbb].first;
+        auto found = result->find(mbb);
+        if(found == result->end()){
+            found = result->insert(std::make_pair(mbb,std::make_pair(initval, initval))).first;
+        }
+        std::pair<T, T> &vals = found->second;
 
+        T bbentryval = vals.first;
 
         for(myBasicBlock* pred : mbb->getPreds()){
+            StatsPhase phase(AnalysisStats::Merge);
             visitor->merge(&bbentryval, (*result)[pred].second);
+            stats.merges++;
         }
         
-        (*result)[mbb].first = bbentryval;
+        vals.first = bbentryval;
         visitor->compDFVal(mbb, &bbentryval, true);
 
         // If outgoing value changed, propagate it along the CFG
-        if (bbentryval == (*result)[mbb].second) continue;
-        (*result)[mbb].second = bbentryval;
+        bool changed = !(bbentryval == vals.second);
+        if(span.enabled()){
+            unsigned size = visitor->getStateSize(bbentryval);
+            span.arg("changed", changed);
+            span.arg("facts", size);
+            if(changed) traceCounter(("facts " + mfn->mf->getName()).str(), size);
+        }
+        if (!changed) continue;
+        vals.second = bbentryval;
 
         for (myBasicBlock* si : mbb->getSuccs()) {
-            worklist.insert(si);
+            worklist.push(si);
         }
 
     }
+}
 
-    return;
+/// 
+/// Compute a forward iterated fixedpoint dataflow function, using a user-supplied
+/// visitor function. Note that the caller must ensure that the function is
+/// in fact a monotone function, as otherwise the fixedpoint may not terminate.
+/// 
+/// @param ctx The analysis the CFG of fn belongs to
+/// @param fn The function
+/// @param visitor A function to compute dataflow vals
+/// @param result The results of the dataflow 
+/// @initval the Initial dataflow value
+template<class T>
+void compForwardDataflow(AnalysisContext &ctx,
+    Function *fn,
+    DataflowVisitor<T> *visitor,
+    typename DataflowResult<T>::Type *result,
+    const T & initval) {
+
+    StatsPhase phase(AnalysisStats::Solve);
+    TraceSpan span("solve", "solve " + fn->getName());
+    unsigned long visits = ctx.worklist.getNumVisits();
+    compForwardDataflow(ctx.buildMyFunc(*fn), ctx.worklist, visitor, result, initval);
+
+    if(span.enabled()){
+        span.arg("visits", (int64_t)(ctx.worklist.getNumVisits() - visits));
+    }
+    if(ShowVisits){
+        errs() << "visits: " << ctx.worklist.getNumVisits() - visits << "\n";
+    }
 }
+
 /// 
 /// Compute a backward iterated fixedpoint dataflow function, using a user-supplied
 /// visitor function. Note that the caller must ensure that the function is
 /// in fact a monotone function, as otherwise the fixedpoint may not terminate.
 /// 
+/// @param ctx The analysis the CFG of fn belongs to
 /// @param fn The function
 /// @param visitor A function to compute dataflow vals
 /// @param result The results of the dataflow 
 /// @initval The initial dataflow value
 template<class T>
-void compBackwardDataflow(Function *fn,
+void compBackwardDataflow(AnalysisContext &ctx,
+    Function *fn,
     DataflowVisitor<T> *visitor,
     typename DataflowResult<T>::Type *result,
     const T &initval) {
-    return ;
+
+    StatsPhase phase(AnalysisStats::Solve);
+    // a backward solve never leaves fn, so its callees need no CFG
+    myFunc* mfn = ctx.buildMyFunc(*fn, false);
+    Worklist blocks(false);
+
+    blocks.setRoot(mfn->getEntryBlock());
+    for(myBasicBlock* mbb: mfn->mbSet){
+        result->insert(std::make_pair(mbb,std::make_pair(initval, initval)));
+        blocks.push(mbb);
+    }
+
+    while(!blocks.empty()) {
+        myBasicBlock * mbb = blocks.pop();
+
+        T bbexitval = (*result)[mbb].second;
+
+        for(myBasicBlock* succ : mbb->mSuccs){
+            StatsPhase phase(AnalysisStats::Merge);
+            visitor->merge(&bbexitval, (*result)[succ].first);
+            stats.merges++;
+        }
+
+        (*result)[mbb].second = bbexitval;
+        visitor->compDFVal(mbb, &bbexitval, false);
+
+        // If incoming value changed, propagate it backward along the CFG
+        if (bbexitval == (*result)[mbb].first) continue;
+        (*result)[mbb].first = bbexitval;
+
+        for (myBasicBlock* pi : mbb->mPreds) {
+            blocks.push(pi);
+        }
+    }
+
+    if(ShowVisits){
+        errs() << "visits: " << blocks.getNumVisits() << "\n";
+    }
+    return;
 }
 
 template<class T>
@@ -249,7 +674,7 @@ void printDataflowResult(raw_ostream &out,
     for ( typename DataflowResult<T>::Type::const_iterator it = dfresult.begin();
             it != dfresult.end(); ++it ) {
         if (it->first == NULL) out << "*";
-        else it->first->dump();
+        else it->first->print(out);
         out << "\n\tin : "
             << it->second.first 
             << "\n\tout :  "
@@ -18,6 +18,7 @@
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/Timer.h>
 
 #include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
@@ -31,6 +32,10 @@
 #include <llvm/Support/raw_ostream.h>
 
 #include "Point2Analysis.h"
+#include "Liveness.h"
+#include "Andersen.h"
+#include "ProgramLoader.h"
+#include "Scheduler.h"
 
 using namespace llvm;
 static ManagedStatic<LLVMContext> GlobalContext;
@@ -53,16 +58,168 @@ char EnableFunctionOptPass::ID = 0;
 //char FuncPtrPass::ID = 0;
 //static RegisterPass<FuncPtrPass> X("funcptrpass", "Print function call instruction");
 
-//char Liveness::ID = 0;
-//static RegisterPass<Liveness> Y("liveness", "Liveness Dataflow Analysis");
+char Liveness::ID = 0;
+static RegisterPass<Liveness> Y("liveness", "Liveness Dataflow Analysis");
 
 char PointAnalysis::ID= 0;
 static RegisterPass<PointAnalysis> X("point2analysis","Points to Set Analysis");
 
-static cl::opt<std::string>
-InputFilename(cl::Positional,
-              cl::desc("<filename>.bc"),
-              cl::init(""));
+char AndersenAnalysis::ID = 0;
+static RegisterPass<AndersenAnalysis> Z("andersen", "Andersen Points to Analysis");
+
+char SteensgaardAnalysis::ID = 0;
+static RegisterPass<SteensgaardAnalysis> W("steensgaard", "Steensgaard Points to Analysis");
+
+enum AnalysisEngine { FlowSensitive, Inclusion, Unification };
+
+static cl::list<std::string>
+InputFilenames(cl::Positional,
+               cl::desc("<filename>.bc... (several files or a directory are analyzed as one program)"),
+               cl::OneOrMore);
+
+static cl::opt<AnalysisEngine>
+Engine("engine",
+       cl::desc("Points-to engine used to resolve calls"),
+       cl::values(clEnumValN(FlowSensitive, "flow", "flow-sensitive dataflow (default)"),
+                  clEnumValN(Inclusion, "andersen", "flow-insensitive inclusion constraints"),
+                  clEnumValN(Unification, "steensgaard", "almost linear unification")),
+       cl::init(FlowSensitive));
+
+static cl::opt<bool>
+RunLiveness("liveness",
+            cl::desc("Also run the liveness analysis and print its result"),
+            cl::init(false));
+
+static cl::opt<bool>
+BatchMode("batch",
+          cl::desc("Analyze every input as a separate module, several at a time"),
+          cl::init(false));
+
+static cl::opt<unsigned>
+BatchJobs("jobs",
+          cl::desc("Number of modules analyzed at once with -batch (default: one per core)"),
+          cl::init(std::thread::hardware_concurrency()));
+
+static cl::opt<bool>
+ReadResults("read-results",
+            cl::desc("Print the result files given, as written by -results, instead of analyzing modules"),
+            cl::init(false));
+
+/// Print what @Store answers: the callees of every reported line, the
+/// blocks with the instructions findBlock() maps elsewhere, and the
+/// facts of each block's states by object name
+static void printResultStore(const ResultStoreReader &Store, raw_ostream &Out) {
+   for (unsigned I = 0; I < Store.getNumLines(); I++) {
+      unsigned Line = Store.getLine(I);
+      Out << Line << ":" << join(Store.getCallees(Line), ",") << "\n";
+   }
+   for (unsigned B = 0; B < Store.getNumBlocks(); B++) {
+      StringRef Fn = Store.getBlockFunction(B);
+      std::pair<unsigned, unsigned> Insts = Store.getBlockInsts(B);
+      Out << "block " << B << " " << Fn << " " << Insts.first << "+" << Insts.second << "\n";
+      for (unsigned Inst = Insts.first; Inst < Insts.first + Insts.second; Inst++) {
+         int Found = Store.findBlock(Fn, Inst);
+         if (Found != (int)B)
+            Out << "  inst " << Inst << " found in block " << Found << "\n";
+      }
+      for (bool Exit : {false, true}) {
+         for (unsigned Obj = 0; Obj < Store.getNumObjects(); Obj++) {
+            ArrayRef<support::ulittle32_t> Pts = Store.getPts(B, Obj, Exit);
+            if (Pts.empty())
+               continue;
+            StringRef Name = Store.getObjectName(Obj);
+            Out << (Exit ? "  out " : "  in ") << Name;
+            if (Store.findObject(Name) < 0)
+               Out << " (not found by name)";
+            Out << ":";
+            for (unsigned Target : Pts)
+               Out << " " << Store.getObjectName(Target);
+            Out << "\n";
+         }
+      }
+   }
+}
+
+/// The passes that analyze a module and print the result to @Out
+static void addAnalysisPasses(legacy::PassManager &Passes, raw_ostream &Out) {
+#if LLVM_VERSION_MAJOR == 5
+   Passes.add(new EnableFunctionOptPass());
+#endif
+   ///Transform it to SSA
+   Passes.add(llvm::createPromoteMemoryToRegisterPass());
+
+   /// Your pass to print Function and Call Instructions
+   if (RunLiveness)
+      Passes.add(new Liveness(Out));
+   if (Engine == Inclusion)
+      Passes.add(new AndersenAnalysis(Out));
+   else if (Engine == Unification)
+      Passes.add(new SteensgaardAnalysis(Out));
+   else
+      Passes.add(new PointAnalysis(Out));
+}
+
+/// Analyze each of @Files on its own, -jobs of them at a time, and print
+/// their results in the order given, followed by the time each took.
+/// Every module gets its own LLVMContext, and the analyses keep their
+/// tables per thread, so workers share nothing.
+static int runBatch(const std::vector<std::string> &Files, const char *Argv0) {
+   struct Outcome {
+      std::string Output;
+      double Seconds = 0;
+      bool Failed = false;
+   };
+   std::vector<Outcome> Outcomes(Files.size());
+
+   // the modules already keep every core busy
+   if (BatchJobs > 1 && Threads.getNumOccurrences() == 0)
+      Threads = 1;
+
+   TimeRecord Start = TimeRecord::getCurrentTime(true);
+   WorkStealingPool Pool(BatchJobs);
+   Pool.forEach(Files.size(), [&](size_t I) {
+      Outcome &Result = Outcomes[I];
+      raw_string_ostream Out(Result.Output);
+      TimeRecord Begin = TimeRecord::getCurrentTime(true);
+
+      // the module's slice has to end before this thread's trace is flushed
+      {
+         TraceSpan Span("module", Files[I]);
+         LLVMContext Context;
+         SMDiagnostic Err;
+         std::unique_ptr<Module> M = parseIRFile(Files[I], Err, Context);
+         if (M) {
+            legacy::PassManager Passes;
+            addAnalysisPasses(Passes, Out);
+            Passes.run(*M);
+         } else {
+            Err.print(Argv0, Out);
+            Result.Failed = true;
+         }
+      }
+
+      Out.flush();
+      flushStats();
+      flushTrace();
+      Result.Seconds = TimeRecord::getCurrentTime(false).getWallTime() - Begin.getWallTime();
+   });
+   double Total = TimeRecord::getCurrentTime(false).getWallTime() - Start.getWallTime();
+
+   bool Failed = false;
+   for (unsigned I = 0; I < Files.size(); I++) {
+      errs() << "== " << Files[I] << " ==\n" << Outcomes[I].Output;
+      Failed |= Outcomes[I].Failed;
+   }
+   errs() << "== timings ==\n";
+   for (unsigned I = 0; I < Files.size(); I++)
+      errs() << format("%9.3f ms  ", Outcomes[I].Seconds * 1000) << Files[I]
+             << (Outcomes[I].Failed ? "  (failed)" : "") << "\n";
+   errs() << format("%9.3f ms  ", Total * 1000) << "total for " << Files.size()
+          << " files, " << Pool.size() << " jobs\n";
+   writeStats();
+   writeTrace();
+   return Failed ? 1 : 0;
+}
 
 
 int main(int argc, char **argv) {
@@ -73,24 +230,55 @@ int main(int argc, char **argv) {
                               "FuncPtrPass \n My first LLVM too which does not do much.\n");
 
 
-   // Load the input module
-   std::unique_ptr<Module> M = parseIRFile(InputFilename, Err, Context);
+   if (ReadResults) {
+      bool Failed = false;
+      for (const std::string &Path : InputFilenames) {
+         ResultStoreReader Store;
+         std::string Error;
+         if (!Store.open(Path, Error)) {
+            errs() << argv[0] << ": " << Path << ": " << Error << "\n";
+            Failed = true;
+            continue;
+         }
+         printResultStore(Store, errs());
+      }
+      return Failed ? 1 : 0;
+   }
+
+   if (BatchMode) {
+      if (!CacheFile.empty() || !ResultFile.empty() || !CallGraphFile.empty()) {
+         errs() << argv[0] << ": -cache, -results and -callgraph name one file and cannot be used with -batch\n";
+         return 1;
+      }
+      std::vector<std::string> Files;
+      for (const std::string &Path : InputFilenames)
+         collectInputs(Path, Files);
+      return runBatch(Files, argv[0]);
+   }
+
+   // Load the input module. A single file is read whole; several files
+   // are linked into one, deserializing only what the entry reaches
+   std::unique_ptr<Module> M;
+   if (InputFilenames.size() == 1 && !sys::fs::is_directory(InputFilenames[0]) && EntryName.empty()) {
+      M = parseIRFile(InputFilenames[0], Err, Context);
+   } else {
+      ProgramLoader Loader(Context);
+      bool Loaded = true;
+      for (const std::string &Path : InputFilenames)
+         Loaded = Loaded && Loader.addInput(Path, Err);
+      if (Loaded)
+         M = Loader.link(EntryName, Err);
+   }
    if (!M) {
       Err.print(argv[0], errs());
       return 1;
    }
 
    llvm::legacy::PassManager Passes;
-#if LLVM_VERSION_MAJOR == 5
-   Passes.add(new EnableFunctionOptPass());
-#endif
-   ///Transform it to SSA
-   Passes.add(llvm::createPromoteMemoryToRegisterPass());
-
-   /// Your pass to print Function and Call Instructions
-   //Passes.add(new Liveness());
-   Passes.add(new PointAnalysis());
+   addAnalysisPasses(Passes, errs());
    Passes.run(*M.get());
+   writeStats();
+   writeTrace();
 #ifndef NDEBUG
    system("pause");
 #endif
@@ -25,6 +25,10 @@ struct LivenessInfo {
    std::set<Instruction *> LiveVars;             /// Set of variables which are live
    LivenessInfo() : LiveVars() {}
    LivenessInfo(const LivenessInfo & info) : LiveVars(info.LiveVars) {}
+   LivenessInfo & operator = (const LivenessInfo & info) {
+       LiveVars = info.LiveVars;
+       return *this;
+   }
   
    bool operator == (const LivenessInfo & info) const {
        return LiveVars == info.LiveVars;
@@ -52,7 +56,7 @@ public:
        }
    }
 
-   void compDFVal(Instruction *inst, LivenessInfo * dfval) override{
+   void compDFVal(Instruction *inst, LivenessInfo * dfval, myBasicBlock*) override{
         if (isa<DbgInfoIntrinsic>(inst)) return;
         dfval->LiveVars.erase(inst);
         for(User::op_iterator oi = inst->op_begin(), oe = inst->op_end();
@@ -69,16 +73,20 @@ class Liveness : public FunctionPass {
 public:
 
    static char ID;
-   Liveness() : FunctionPass(ID) {} 
+   AnalysisContext ctx;
+   raw_ostream &out;     /// where the result goes
+   Liveness() : FunctionPass(ID), out(errs()) {} 
+   explicit Liveness(raw_ostream &o) : FunctionPass(ID), out(o) {}
 
    bool runOnFunction(Function &F) override {
-       F.dump();
+       if (F.isDeclaration()) return false;
+
        LivenessVisitor visitor;
        DataflowResult<LivenessInfo>::Type result;
        LivenessInfo initval;
 
-       compBackwardDataflow(&F, &visitor, &result, initval);
-       printDataflowResult<LivenessInfo>(errs(), result);
+       compBackwardDataflow(ctx, &F, &visitor, &result, initval);
+       printDataflowResult<LivenessInfo>(out, result);
        return false;
    }
 };
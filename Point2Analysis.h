@@ -1,153 +1,578 @@
+#ifndef _POINT2ANALYSIS_H_
+#define _POINT2ANALYSIS_H_
+
 
 #include <llvm/IR/Function.h>
 #include <llvm/Pass.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/IntrinsicInst.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/GetElementPtrTypeIterator.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Operator.h>
+#include <climits>
+#include <array>
+#include <memory>
 
 #include "Dataflow.h"
+#include "PointsToSet.h"
+#include "Steensgaard.h"
+#include "AnalysisCache.h"
+#include "CallGraph.h"
+#include "CallTable.h"
+#include "ResultStore.h"
 using namespace llvm;
 
-std::map<Function*, myFunc*> func2myfunc;
-extern std::set<myBasicBlock* > worklist;
-
+///
+/// Points-to state at a program point. The slots are kept in chunks of
+/// ChunkSize, and both the chunk vector and every chunk are reference
+/// counted and shared between copies, so copying a state is O(1). The
+/// first write to a shared state clones the vector and the one chunk it
+/// writes to, so writes never leak into other blocks' states, and states
+/// that differ in a few slots still share all their other chunks, which
+/// merges and comparisons skip without looking inside.
+///
 struct Point2SetInfo {
-    std::map<Value*, std::set<Value *> *> IntraPts;
-    std::set<Value* > registedValues;
-    std::map<Value*, std::set<Function*>*> call2Funcs;
+    static const unsigned ChunkBits = 6;
+    static const unsigned ChunkSize = 1u << ChunkBits;
+    typedef std::array<PtsRef, ChunkSize> Chunk;
+    typedef std::vector<std::shared_ptr<Chunk> > Chunks;
+
+    std::shared_ptr<Chunks> IntraPts;   /// interned points-to set of each value, indexed by object id
 
     Point2SetInfo() : IntraPts() {}
     Point2SetInfo(const Point2SetInfo & info) : IntraPts(info.IntraPts) {}
-    bool operator == (const Point2SetInfo & info){
-        return IntraPts == info.IntraPts; 
+    Point2SetInfo & operator = (const Point2SetInfo & info) {
+        IntraPts = info.IntraPts;
+        return *this;
     }
-    
-    void add_node(Value* v){
-        registedValues.insert(v) ;
-        IntraPts.insert({v,new std::set<Value*>()});
+
+    /// Chunks for writing, the vector cloned first if another state shares it
+    Chunks& mutableChunks(){
+        if(!IntraPts)
+            IntraPts = std::make_shared<Chunks>();
+        else if(IntraPts.use_count() > 1)
+            IntraPts = std::make_shared<Chunks>(*IntraPts);
+        return *IntraPts;
     }
 
-    void set_union(std::set<Value*>* dest,std::set<Value*>* src){
-        dest->insert(src->begin(),src->end());
-    } 
+    /// Chunk @i for writing, cloned first if another state shares it
+    Chunk& mutableChunk(unsigned i){
+        Chunks &chunks = mutableChunks();
+        if(i >= chunks.size())
+            chunks.resize(i+1);
+        std::shared_ptr<Chunk> &chunk = chunks[i];
+        if(!chunk)
+            chunk = std::make_shared<Chunk>(Chunk());
+        else if(chunk.use_count() > 1)
+            chunk = std::make_shared<Chunk>(*chunk);
+        return *chunk;
+    }
+
+    /// Share chunk @i of another state
+    void shareChunk(unsigned i, const std::shared_ptr<Chunk> &chunk){
+        Chunks &chunks = mutableChunks();
+        if(i >= chunks.size())
+            chunks.resize(i+1);
+        chunks[i] = chunk;
+    }
+
+    const Chunk* getChunk(unsigned i) const {
+        return IntraPts && i < IntraPts->size() ? (*IntraPts)[i].get() : nullptr;
+    }
+
+    unsigned getNumChunks() const {
+        return IntraPts ? IntraPts->size() : 0;
+    }
+
+    PtsRef getSlot(unsigned id) const {
+        const Chunk* chunk = getChunk(id >> ChunkBits);
+        return chunk ? (*chunk)[id & (ChunkSize-1)] : nullptr;
+    }
+
+    void setSlot(unsigned id, PtsRef set){
+        if(getSlot(id) == set) return;
+        mutableChunk(id >> ChunkBits)[id & (ChunkSize-1)] = set;
+    }
+
+    /// Call @fn with the id and the set of every slot that has facts, by id
+    template<class Fn>
+    void forEachSlot(Fn fn) const {
+        for(unsigned i=0;i<getNumChunks();i++){
+            const Chunk* chunk = getChunk(i);
+            if(!chunk) continue;
+            for(unsigned j=0;j<ChunkSize;j++){
+                if((*chunk)[j]) fn((i << ChunkBits) | j, (*chunk)[j]);
+            }
+        }
+    }
+
+    static bool isEmpty(const Chunk* chunk){
+        return !chunk || std::all_of(chunk->begin(), chunk->end(), [](PtsRef set){ return !set; });
+    }
+
+    bool operator == (const Point2SetInfo & info) const {
+        if(IntraPts == info.IntraPts) return true;
+
+        unsigned n = std::max(getNumChunks(), info.getNumChunks());
+        for(unsigned i=0;i<n;i++){
+            const Chunk* mine = getChunk(i);
+            const Chunk* theirs = info.getChunk(i);
+            if(mine == theirs) continue;
+            // a chunk never written on one side is all empty there
+            if(!mine || !theirs){
+                if(!isEmpty(mine ? mine : theirs)) return false;
+                continue;
+            }
+            // interned sets are equal iff they are the same pointer
+            if(*mine != *theirs) return false;
+        }
+        return true;
+    }
 
     void addPoint2Edge(Value* pre, Value* suc){
         assert(pre);
+        unsigned preid = objIndex.getID(pre);
+        setSlot(preid, ptsTable.insert(getSlot(preid), objIndex.getID(suc)));
+    }
 
-        if(IntraPts.find(pre) == IntraPts.end())
-            add_node(pre);
+    /// pts(pre) |= pts(src), true if pts(pre) grew
+    bool addPts(Value* pre, Value* src){
+        unsigned preid = objIndex.getID(pre);
+        PtsRef old = getSlot(preid);
+        PtsRef merged = ptsTable.unite(old, getSlot(objIndex.getID(src)));
+        if(merged == old) return false;
+        setSlot(preid, merged);
+        return true;
+    }
 
-        IntraPts[pre]->insert(suc);         
+    /// pts(pre) |= sucs, true if pts(pre) grew
+    bool addPts(Value* pre, const PtsSet & sucs){
+        unsigned preid = objIndex.getID(pre);
+        PtsRef old = getSlot(preid);
+        PtsRef merged = ptsTable.unite(old, ptsTable.intern(sucs));
+        if(merged == old) return false;
+        setSlot(preid, merged);
+        return true;
     }
-    
-    void addPts(Value* pre,std::set<Value*>* sucs){
-        if(IntraPts.find(pre)==IntraPts.end()){
-            IntraPts.insert({pre, new std::set<Value*>()});
-        }
-        
-        set_union(IntraPts[pre],sucs);
-    } 
-    
 
     void rmPts(Value* pre){
         assert(pre);
-        if(IntraPts.find(pre)==IntraPts.end()){
-            add_node(pre);
-        }
-        IntraPts[pre]->clear();
+        setSlot(objIndex.getID(pre), nullptr);
+    }
+
+    const PtsSet& getPts(Value* pre) const {
+        static const PtsSet empty;
+        PtsRef set = getSlot(objIndex.getID(pre));
+        return set ? *set : empty;
     }
 
-    std::set<Value*>* getPts(Value* pre){
-        return IntraPts[pre]; 
+    bool isPoint2SetEmpty(Value* pre) const {
+        return getPts(pre).empty();
     }
 
-    bool isPoint2SetEmpty(Value* pre){
+    /// Union of every slot of @src into this, memoized per pair of sets.
+    /// Chunks both sides share are skipped, and a chunk that gains nothing,
+    /// or only what @src has, stays shared.
+    void unionWith(const Point2SetInfo & src){
+        if(IntraPts == src.IntraPts || !src.IntraPts) return;
+        if(!IntraPts){
+            IntraPts = src.IntraPts;
+            return;
+        }
+
+        for(unsigned i=0;i<src.getNumChunks();i++){
+            const std::shared_ptr<Chunk> &from = (*src.IntraPts)[i];
+            const Chunk* mine = getChunk(i);
+            if(!from || mine == from.get()) continue;
+            if(isEmpty(mine)){
+                shareChunk(i, from);
+                continue;
+            }
 
-        return !(IntraPts[pre] && IntraPts[pre]->empty());
+            Chunk merged;
+            bool grows = false, covered = true;
+            for(unsigned j=0;j<ChunkSize;j++){
+                merged[j] = ptsTable.unite((*mine)[j], (*from)[j]);
+                grows |= merged[j] != (*mine)[j];
+                covered &= merged[j] == (*from)[j];
+            }
+            if(!grows) continue;
+            if(covered)
+                shareChunk(i, from);
+            else
+                mutableChunk(i) = merged;
+        }
     }
-    
 };
 
 inline raw_ostream &operator<<(raw_ostream &out, const Point2SetInfo &pts) {
-  for (const auto v : pts.IntraPts) {
-    if (v.first->hasName()) {
-      out << v.first->getName();
-    } else {
-      out << "%*"; 
-    }
+  pts.forEachSlot([&](unsigned id, PtsRef set) {
+    const PtsSet &s = *set;
+
+    Value *v = objIndex.getObject(id);
+    out << objIndex.getName(id, v->hasName() ? v->getName() : "%*");
     out << ": {";
 
-    const auto s = v.second;
-    for (auto iter = s->begin(); iter != s->end(); iter++) {
-      if (iter != s->begin()) {
+    for (auto iter = s.begin(); iter != s.end(); ++iter) {
+      if (iter != s.begin()) {
         out << ", ";
       }
-      out << (*iter)->getName();
+      out << objIndex.getName(*iter, objIndex.getObject(*iter)->getName());
     }
     out << "}\n";
-  }
+  });
   return out;
 }
 	
+class Point2AnalysisVisitor;
+
+static cl::opt<int> CallStringDepth("kcfa",
+    cl::desc("Key callee summaries by their last k call sites instead of by the facts passed in (-1)"),
+    cl::init(-1));
+
+static cl::opt<unsigned> ContextBudget("context-budget",
+    cl::desc("Most callee summaries kept apart, later contexts share one per function (0: no limit)"),
+    cl::init(0));
+
+///
+/// Interned calling contexts. A context is a string of pointers, either
+/// the call sites a call was reached through or the facts it passes in,
+/// and is stored once and named by a dense id. Id 0 is the empty context.
+///
+class ContextTable {
+    std::map<std::vector<const void*>, unsigned> ids;
+    std::vector<std::vector<const void*> > keys;
+
+public:
+    ContextTable() {
+        intern({});
+    }
+
+    unsigned intern(const std::vector<const void*> &key){
+        auto known = ids.find(key);
+        if(known != ids.end()) return known->second;
+
+        unsigned id = keys.size();
+        ids.insert({key, id});
+        keys.push_back(key);
+        return id;
+    }
+
+    /// @context followed by @callsite, keeping the last @k call sites
+    unsigned push(unsigned context, CallInst* callsite, unsigned k){
+        if(k == 0) return 0;
+        const std::vector<const void*> &outer = keys[context];
+        unsigned keep = std::min<size_t>(outer.size(), k - 1);
+        std::vector<const void*> key(outer.end() - keep, outer.end());
+        key.push_back(callsite);
+        return intern(key);
+    }
+
+    unsigned size() const {
+        return keys.size();
+    }
+};
+
+///
+/// Transfer summaries of callees, applied at call sites instead of
+/// splicing the callee CFG into the caller. A summary maps the facts a
+/// function reads from its caller (its input) to the facts it leaves at
+/// its exit (its effects). There is one summary per function and calling
+/// context: by default the context is the input itself, with -kcfa=k it
+/// is the last k call sites and the inputs of all calls in the context
+/// are merged. Each summary is solved over the function's own CFG. Calls
+/// inside that solve apply their own summaries, and recursive calls
+/// iterate until the summaries on the cycle stop growing. Once
+/// -context-budget summaries exist, new contexts fall back to a single
+/// merged summary per function.
+///
+class CallSummaries {
+    struct Summary {
+        Point2SetInfo input;                  /// join of the inputs of every call in the context
+        DenseMap<unsigned, PtsRef> effects;   /// slot -> facts a call may add to it
+        PtsRef ret = nullptr;                 /// what a call may return
+        unsigned context = 0;
+        bool done = false;
+        unsigned reads = UINT_MAX;            /// depth of the active solve whose partial effects a done summary read
+        bool active = false;                  /// being solved, the effects are partial
+        bool widened = false;                 /// input grew while active
+        unsigned depth = 0;                   /// position in the solve stack while active
+        DenseSet<Function*> deps;             /// functions whose summaries the solve applied
+        bool reports = false;                 /// the solve reported calls, so it is not cached
+        bool ahead = false;                   /// solved by prepare() for the call about to apply it
+    };
+
+    AnalysisContext* ctx;
+    ContextTable contexts;
+    std::map<Function*, std::vector<unsigned> > inputs;
+    std::map<Function*, std::map<unsigned, Summary> > table;
+    unsigned numSummaries = 0;
+    std::vector<Summary*> solving;   /// every active solve, innermost last
+    std::vector<myBasicBlock*> solvingEntry;
+    std::vector<std::vector<Summary*> > waiting;   /// per active solve: done summaries that read it
+    unsigned lowest = UINT_MAX;      /// shallowest active summary read by the innermost solve
+    const StableNames* names = nullptr;   /// names across runs, set when a cache is used
+    std::map<Function*, std::map<std::string, CachedSummary> > cached;   /// fn -> summaries by named input
+
+    static bool isInput(Function* fn, Value* v);
+    bool nameNode(Point2AnalysisVisitor* visitor, Function* fn, unsigned id, std::vector<unsigned> &callers,
+                  bool bind, std::string &name);
+    bool nameFacts(Point2AnalysisVisitor* visitor, Function* fn, unsigned id, PtsRef set,
+                   std::vector<unsigned> &callers, bool bind, CachedSummary::Facts &facts);
+    static std::string getInputKey(const CachedSummary::Facts &input);
+    void loadSummary(Point2AnalysisVisitor* visitor, Function* fn, const Point2SetInfo &input,
+                     unsigned context);
+    void addInputs(Point2AnalysisVisitor* visitor, Function* fn, DenseSet<unsigned> &ids);
+    const std::vector<unsigned>& getInputs(Point2AnalysisVisitor* visitor, Function* fn);
+    Summary& getSummary(Function* fn, unsigned context);
+    Summary& getCallSummary(Point2AnalysisVisitor* visitor, CallInst* callinst, Function* fn,
+                            const Point2SetInfo &in);
+    void compSummary(Point2AnalysisVisitor* visitor, Function* fn, Summary &sum);
+
+    /// Solve the summaries in @readers past @keep again when next needed
+    static void invalidate(std::vector<Summary*> &readers, size_t keep){
+        for(size_t i=keep;i<readers.size();i++) readers[i]->done = false;
+        readers.resize(keep);
+    }
+
+public:
+    unsigned long solved = 0;
+    unsigned long reused = 0;
+    unsigned long visits = 0;
+    unsigned long loaded = 0;
+    unsigned long closed = 0;        /// summaries finished along with their cycle
+
+    CallSummaries(AnalysisContext* c) : ctx(c) {}
+
+    /// Input of the innermost solve if @mbb is its entry block, else null
+    const Point2SetInfo* getEntryInput(myBasicBlock* mbb) const {
+        if(solving.empty() || solvingEntry.back() != mbb) return nullptr;
+        return &solving.back()->input;
+    }
+
+    unsigned getNumContexts() const {
+        return contexts.size();
+    }
+
+    unsigned getNumSummaries() const {
+        return numSummaries;
+    }
+
+    /// Solve the summaries that @callinst calling @bodies with the facts
+    /// @in is missing side by side, before apply() uses them. Callees that
+    /// report no calls apply no summaries, so their solves only share the
+    /// IR: each one is a job on a work-stealing pool of the context's
+    /// threads, with an object index and a set table of its own, and
+    /// hands its summary back by node paths.
+    void prepare(Point2AnalysisVisitor* visitor, CallInst* callinst, ArrayRef<Function*> bodies,
+                 const Point2SetInfo &in);
+
+    /// Add the effects of @callinst calling @fn with the facts @in to @out.
+    /// The pointer arguments of this call alone are bound to @fn's
+    /// parameters.
+    void apply(Point2AnalysisVisitor* visitor, CallInst* callinst, Function* fn,
+               const Point2SetInfo &in, Point2SetInfo* out);
+
+    /// Add the finished summaries that can be named across runs to @cache.
+    /// The objects of the callers are named by where the input reaches
+    /// them, so a summary outlives edits to its callers.
+    void exportTo(AnalysisCache &cache, const StableNames &names, Point2AnalysisVisitor* visitor);
+
+    /// Take over the summaries @cache still holds valid for this module,
+    /// each for the calls whose input it matches
+    void importFrom(Module &M, const AnalysisCache &cache, const StableNames &names,
+                    Point2AnalysisVisitor* visitor);
+};
+
 class Point2AnalysisVisitor : public DataflowVisitor<struct Point2SetInfo> {
 public:
-    Point2AnalysisVisitor() {}
+    Point2AnalysisVisitor(AnalysisContext* c = nullptr) : ctx(c) {}
 
-    std::map<unsigned, std::set<std::string>*> mOutput;
+    AnalysisContext* ctx;                 /// CFGs that callees get spliced into
+    const DataLayout* layout = nullptr;   /// byte offsets of struct fields
+    CallTable mOutput;
+    CallGraph callGraph;                  /// direct calls and the callees resolved so far
+    SteensgaardSolver* seed = nullptr;    /// if set, only its callees get wired in
+    CallSummaries* summaries = nullptr;   /// if set, callees are summarized instead of spliced
+    DenseSet<Value*> singleSites;         /// allocation sites whose heap object is one object
+
+    void printResult(raw_ostream &out){
+        mOutput.print(out);
+    }
 
     void showResult(){
-        for(std::map<unsigned, std::set<std::string>*>::iterator i=mOutput.begin(), j=mOutput.end(); i!=j; i++){
-            unsigned line =i->first;
-            std::set<std::string> funcs = *(i->second);
-            errs()<<line<<":";
-            int flag = 1; 
-            for(std::string ii:funcs){
-                if(flag){
-                    errs()<<ii;
-                    flag = 0;
-                }
-                else
-                    errs()<<","<<ii;
-            }
-            errs()<<"\n";
-        }
+        printResult(errs());
     }
     
     void handleAllocaInst(AllocaInst* allocainst, Point2SetInfo* dfval){
         return ;   
     }
 
+    /// Byte offset of the field @gep selects. Array elements all fall on
+    /// the first one, which sets @elements, but a constant index over
+    /// bytes is an offset in bytes, as char pointer arithmetic and
+    /// offsetof make them.
+    uint64_t getFieldOffset(GEPOperator* gep, bool &elements){
+        uint64_t offset = 0;
+        elements = false;
+        for(gep_type_iterator gi = gep_type_begin(gep), ge = gep_type_end(gep); gi != ge; ++gi){
+            StructType* st = gi.getStructTypeOrNull();
+            if(!st){
+                ConstantInt* index = dyn_cast<ConstantInt>(gi.getOperand());
+                if(index && gi.getIndexedType()->isIntegerTy(8)) offset += index->getSExtValue();
+                // the leading 0 of &p->f stays on the object p points to
+                else if(!index || !index->isZero() || gi != gep_type_begin(gep)) elements = true;
+                continue;
+            }
+            unsigned field = cast<ConstantInt>(gi.getOperand())->getZExtValue();
+            offset += layout->getStructLayout(st)->getElementOffset(field);
+        }
+        return offset;
+    }
+
+    void addPointees(Value* v, const Point2SetInfo &dfval, SmallVectorImpl<unsigned> &ids,
+                     SmallPtrSetImpl<Value*> &phis){
+        if(GEPOperator* gep = dyn_cast<GEPOperator>(v)){
+            unsigned first = ids.size();
+            addPointees(gep->getPointerOperand(), dfval, ids, phis);
+            bool elements;
+            uint64_t offset = getFieldOffset(gep, elements);
+            for(unsigned i=first;i<ids.size();i++){
+                if(offset != 0) ids[i] = objIndex.getFieldID(ids[i], offset);
+                if(elements) objIndex.setCollapsed(ids[i]);
+            }
+        }
+        else if(isa<BitCastOperator>(v) || isa<AddrSpaceCastOperator>(v)){
+            addPointees(cast<Operator>(v)->getOperand(0), dfval, ids, phis);
+        }
+        else if(PHINode* phi = dyn_cast<PHINode>(v)){
+            if(!phis.insert(phi).second) return ;
+            for(Value* in : phi->incoming_values()){
+                addPointees(in, dfval, ids, phis);
+            }
+        }
+        else if(SelectInst* select = dyn_cast<SelectInst>(v)){
+            addPointees(select->getTrueValue(), dfval, ids, phis);
+            addPointees(select->getFalseValue(), dfval, ids, phis);
+        }
+        else if(isa<AllocaInst>(v) || isa<GlobalValue>(v)){
+            ids.push_back(objIndex.getID(v));
+        }
+        else if(!isa<Constant>(v)){
+            unsigned id = objIndex.getID(v);
+            if(objIndex.isHeap(id)){
+                ids.push_back(id);
+            }
+            else if(PtsRef set = dfval.getSlot(id)){
+                for(unsigned obj : *set) ids.push_back(obj);
+            }
+            else{
+                ids.push_back(objIndex.getTargetID(id));
+            }
+        }
+    }
+
+    ///
+    /// Nodes the pointer @v may point to, given the facts @dfval. Allocas,
+    /// globals, functions and allocation sites point to themselves;
+    /// casts, phis and selects to what their operands point to; a GEP to
+    /// its field of what its base points to. Any other pointer points to
+    /// its facts, or to its own target while it has none.
+    ///
+    void getPointees(Value* v, const Point2SetInfo &dfval, SmallVectorImpl<unsigned> &ids){
+        SmallPtrSet<Value*, 4> phis;
+        addPointees(v, dfval, ids, phis);
+        if(ids.size() > 1){
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        }
+    }
+
+    PtsRef getPointees(Value* v, const Point2SetInfo &dfval){
+        SmallVector<unsigned, 4> ids;
+        getPointees(v, dfval, ids);
+        return ptsTable.intern(ids);
+    }
+
+    /// Only pointers can lead to functions, other values are not tracked
     void handleLoadInst(LoadInst* loadinst, Point2SetInfo * dfval){
-        /*
-        Value* address = loadinst->getPointerOperand();
-        std::set<Value*>* s = dfval->getPoint2Set(address);
-        Value* pre = dyn_cast<Value>(loadinst);
-        dfval->removePoint2Set(pre);
-
-        for(std::set<Value*>::iterator i=s->begin();i!=s->end();i++){
-            std::set<Value*> sucs = dfval->getPoint2Set(i);
-            dfval->addPts(pre, sucs); 
-        }
-        */
-        Value* suc = loadinst->getPointerOperand();
-        Value* pre = dyn_cast<Value>(loadinst);
-        dfval->rmPts(pre);
-        dfval->addPts(pre, dfval->getPts(suc));
+        if(!loadinst->getType()->isPointerTy()) return ;
+
+        SmallVector<unsigned, 4> from;
+        getPointees(loadinst->getPointerOperand(), *dfval, from);
+        PtsRef loaded = nullptr;
+        for(unsigned loc : from){
+            loaded = ptsTable.unite(loaded, dfval->getSlot(loc));
+        }
+        dfval->setSlot(objIndex.getID(loadinst), loaded);
     }
     
+    /// Note the allocation sites of @root that allocate at most one
+    /// object per run: those outside its loops, if nothing it calls can
+    /// enter it again. Before the solve only direct calls are known, so
+    /// an indirect call is taken to reach every function whose address
+    /// is taken, and @root must be on no cycle of that call graph.
+    void findSingleSites(Function* root){
+        if(root->hasAddressTaken()) return ;
+        Module &M = *root->getParent();
+        CallGraph calls;
+        calls.addDirectCalls(M);
+        std::vector<Function*> taken;
+        for(Function &fn : M){
+            if(fn.hasAddressTaken()) taken.push_back(&fn);
+        }
+        for(Function &fn : M){
+            for(Instruction &inst : instructions(fn)){
+                CallInst* callinst = dyn_cast<CallInst>(&inst);
+                if(!callinst || isa<Function>(callinst->getCalledOperand()->stripPointerCasts())) continue;
+                for(Function* f : taken) calls.addEdge(callinst, f);
+            }
+        }
+        if(calls.isInCycle(root)) return ;
+        for(scc_iterator<Function*> scc = scc_begin(root); !scc.isAtEnd(); ++scc){
+            if(scc.hasCycle()) continue;
+            for(Instruction &inst : *(*scc)[0]){
+                if(getAllocator(&inst)) singleSites.insert(&inst);
+            }
+        }
+    }
+
+    /// Whether a store through a pointer to the nodes @to overwrites
+    /// them: there is one, it is no collapsed node of several fields or
+    /// elements, and no part of a heap object that stands for several
+    /// objects its site allocates
+    bool isStrongUpdate(ArrayRef<unsigned> to) const {
+        if(to.size() != 1 || objIndex.isCollapsed(to[0])) return false;
+        Value* obj = objIndex.getObject(to[0]);
+        return !objIndex.isHeap(obj) || singleSites.count(obj);
+    }
+
     void handleStoreInst(StoreInst* storeinst,Point2SetInfo* dfval){
         Value* y = storeinst->getValueOperand();
-        Value* x = storeinst->getPointerOperand(); 
+        if(!y->getType()->isPointerTy()) return ;
 
-        dfval->rmPts(x);
-        dfval->addPoint2Edge(x,y);
+        SmallVector<unsigned, 4> to;
+        getPointees(storeinst->getPointerOperand(), *dfval, to);
+        PtsRef stored = getPointees(y, *dfval);
+        // a store to one node overwrites it, one to several may not
+        // reach each of them
+        if(isStrongUpdate(to)){
+            dfval->setSlot(to[0], stored);
+            return ;
+        }
+        for(unsigned loc : to){
+            dfval->setSlot(loc, ptsTable.unite(dfval->getSlot(loc), stored));
+        }
     } 
 
-    void init_new_func(Function* fn, CallInst* callinst, myBasicBlock* curBB){
-        myFunc* mfn = func2myfunc[fn] ;
-        myBasicBlock* entry = mfn->getEntryBlock();
-        myBasicBlock* exit = mfn->getExitBlock();
-        
-        myBasicBlock* nexit;
+    /// Block a callee of @callinst, which ends @curBB, returns to
+    static myBasicBlock* getReturnBlock(CallInst* callinst, myBasicBlock* curBB){
+        myBasicBlock* nexit = nullptr;
         auto splitline = callinst->getIterator(); 
         ++splitline;
         for(myBasicBlock* succ:curBB->getSuccs()){
@@ -157,71 +582,181 @@ public:
             }
         }
 
-        assert(nexit->getBeginInst()==splitline) ;
+        assert(nexit && nexit->getBeginInst()==splitline) ;
+        return nexit;
+    }
+
+    void init_new_func(Function* fn, CallInst* callinst, myBasicBlock* curBB){
+        stats.splices++;
+        myFunc* mfn = ctx->buildMyFunc(*fn);
+        myBasicBlock* entry = mfn->getEntryBlock();
+        myBasicBlock* exit = mfn->getExitBlock();
+        myBasicBlock* nexit = getReturnBlock(callinst, curBB);
 
         curBB->addSucc(entry);
         exit->addSucc(nexit); 
+        ctx->worklist.invalidateOrder();
         
         for(myBasicBlock* mbb : mfn->mbSet){
-            worklist.insert(mbb);
+            ctx->worklist.push(mbb);
         } 
     } 
 
-    void handleCallInst(CallInst* callinst, Point2SetInfo* dfval, myBasicBlock* curBB){
-        
-        Function* fff = callinst->getFunction();
-        if(fff->getName()!="moo") return ;
+    /// Whether the calls of @fn are resolved and reported
+    bool reportsCalls(Function* fn) const {
+        return fn->getName() == "moo";
+    }
+
+    /// Output slot for the source line of @callinst, or null if the call
+    /// is not reported. Calls to intrinsics never are.
+    LineCallees* getCallOutput(CallInst* callinst){
+        if(!reportsCalls(callinst->getFunction())) return nullptr;
+        Function* direct = callinst->getCalledFunction();
+        if(direct && direct->isIntrinsic()) return nullptr;
 
-        Value* callop = callinst->getCalledOperand(); 
         unsigned line = callinst->getDebugLoc().getLine(); 
-        unsigned argnum = callinst->getNumArgOperands();     
+        return mOutput.getLine(line);
+    }
+
+    /// Objects @callinst may call, given the points-to facts in @pts
+    PtsSet getCallees(CallInst* callinst, const Point2SetInfo & pts){
+        Value* callop = callinst->getCalledOperand(); 
+
+        // a direct call only ever reaches its own callee, and an
+        // intrinsic is no callee at all
+        if(Function* f = dyn_cast<Function>(callop)){
+            PtsSet direct;
+            if(!f->isIntrinsic()) direct.set(objIndex.getID(f));
+            return direct;
+        }
+        SmallVector<unsigned, 4> ids;
+        getPointees(callop, pts, ids);
+        PtsSet callees;
+        for(unsigned id : ids) callees.set(id);
+        return callees;
+    }
 
-        if(mOutput.find(line)==mOutput.end()){
-            mOutput.insert({line, new std::set<std::string>()});
+    /// Record @f as a callee of @callinst, splicing its body into the CFG
+    /// the first time it shows up at this call. Returns false if the seed
+    /// rules @f out.
+    bool addCallee(CallInst* callinst, Function* f, LineCallees* names, myBasicBlock* curBB){
+        if(seed && !seed->mayCall(callinst, f)) return false;
+
+        if(names->insert(f)){
+            traceInstant("call", "target " + f->getName(), [&](json::OStream &out){
+                out.attribute("line", (int64_t)callinst->getDebugLoc().getLine());
+                out.attribute("targets", (int64_t)names->size());
+            });
         }
-        std::set<std::string>* names = mOutput[line];
+        if(callGraph.addEdge(callinst, f) && !f->isDeclaration() && !summaries)
+            init_new_func(f,callinst,curBB); 
+        return true;
+    }
 
-        if(callop->getName() == "malloc"){
-            names->insert("malloc");            
-            return;
+    ///
+    /// The heap object of @callinst is what it points to. An allocator
+    /// taking a pointer, like realloc, moves the contents of what that
+    /// points to, fields included, into the new object.
+    ///
+    void handleAllocation(CallInst* callinst, Point2SetInfo* dfval, LineCallees* names){
+        unsigned site = objIndex.getID(callinst);
+        if(names) names->insert(getAllocator(callinst));
+        if(!callinst->arg_size() || !callinst->getArgOperand(0)->getType()->isPointerTy()) return ;
+
+        SmallVector<unsigned, 4> from;
+        getPointees(callinst->getArgOperand(0), *dfval, from);
+        for(unsigned obj : from){
+            if(obj == site) continue;
+            dfval->setSlot(site, ptsTable.unite(dfval->getSlot(site), dfval->getSlot(obj)));
+            for(unsigned field : objIndex.getChildren(obj)){
+                unsigned parent;
+                uint64_t offset;
+                objIndex.getDerived(field, parent, offset);
+                if(offset == ObjectIndex::Target) continue;
+                unsigned to = objIndex.getFieldID(site, offset);
+                dfval->setSlot(to, ptsTable.unite(dfval->getSlot(to), dfval->getSlot(field)));
+            }
         }
+    }
+
+    void handleCallInst(CallInst* callinst, Point2SetInfo* dfval, myBasicBlock* curBB){
         
-        std::set<Value*>* callfuncs = dfval->getPts(callop); 
+        LineCallees* names = getCallOutput(callinst);
+        if(objIndex.isHeap(callinst)){
+            handleAllocation(callinst, dfval, names);
+            return ;
+        }
+        if(!names) return ;
+
+        StatsPhase phase(AnalysisStats::CallHandling);
+        stats.callsHandled++;
+        TraceSpan span("call");
+        if(span.enabled()){
+            span.setName("call line " + Twine(callinst->getDebugLoc().getLine()));
+        }
+        unsigned argnum = callinst->arg_size();     
+
+        PtsSet callfuncs = getCallees(callinst, *dfval);
+        std::vector<Function*> bodies;
+        if(span.enabled()){
+            span.arg("callees", (int64_t)callfuncs.count());
+        }
     
-        for(Value* func: *callfuncs){
-            Function* f = dyn_cast<Function>(func);
+        for(unsigned funcid: callfuncs){
+            Function* f = dyn_cast<Function>(objIndex.getObject(funcid));
+            if(!f) continue;
 
             //new function
-            if(names->find(f->getName())==names->end()){
-                //add to print result 
-                names->insert(f->getName());
-                init_new_func(f,callinst,curBB); 
-            }
+            if(!addCallee(callinst, f, names, curBB)) continue;
+            if(f->isDeclaration()) continue;
 
             //compute dataflow infomation of func
 
-            for(unsigned i=0;i<argnum;i++){
+            // summaries bind the arguments of each call on their own
+            if(summaries){
+                bodies.push_back(f);
+                continue;
+            }
+            for(unsigned i=0;i<argnum && i<f->arg_size();i++){
                 Value* argi = callinst->getArgOperand(i);
                 if(argi->getType()->isPointerTy()){
-                    Value* fargi = f->getArg(i);
-                    dfval->addPts(fargi,dfval->getPts(argi));
+                    unsigned fargi = objIndex.getID(f->getArg(i));
+                    dfval->setSlot(fargi, ptsTable.unite(dfval->getSlot(fargi), getPointees(argi, *dfval)));
                 }
             }
-            
         } 
 
+        // every callee starts from the facts at the call, and the call may
+        // also bypass all of them
+        if(!bodies.empty()){
+            Point2SetInfo in = *dfval;
+            // the call defines its result anew from what its callees return
+            dfval->rmPts(callinst);
+            summaries->prepare(this, callinst, bodies, in);
+            for(Function* f : bodies){
+                summaries->apply(this, callinst, f, in, dfval);
+            }
+        }
         return ;
     }
 
     void merge(Point2SetInfo* dest, const Point2SetInfo & src) override{
-        const auto &srcPts = src.IntraPts;
+        dest->unionWith(src);
+    }
 
-        for(const auto &pts:srcPts){
-            Value* pre = pts.first;
-            std::set<Value*>* sucs = pts.second;
+    unsigned getStateSize(const Point2SetInfo & dfval) override{
+        unsigned size = 0;
+        dfval.forEachSlot([&](unsigned, PtsRef){ size++; });
+        return size;
+    }
 
-            dest->addPts(pre,sucs);
+    void compDFVal(myBasicBlock *mblock, Point2SetInfo *dfval, bool isforward) override {
+        // a summary solve starts from the facts of its call site
+        if(summaries){
+            if(const Point2SetInfo* input = summaries->getEntryInput(mblock))
+                dfval->unionWith(*input);
         }
+        DataflowVisitor<Point2SetInfo>::compDFVal(mblock, dfval, isforward);
     }
 
     void compDFVal(Instruction* inst, Point2SetInfo * dfval, myBasicBlock* mbb) override{
@@ -243,89 +778,1105 @@ public:
 };
 
 
+/// Whether @fn reads the caller's fact for @v: values it loads itself are
+/// always redefined before use
+bool CallSummaries::isInput(Function* fn, Value* v){
+    LoadInst* loadinst = dyn_cast<LoadInst>(v);
+    return !loadinst || loadinst->getFunction() != fn;
+}
+
+/// Add the slots @fn reads whatever the facts: its pointer parameters
+/// and the nodes its loads read from when no pointer is known to point
+/// anywhere. What the parameters point to is added per call.
+void CallSummaries::addInputs(Point2AnalysisVisitor* visitor, Function* fn, DenseSet<unsigned> &ids){
+    for(Argument &arg : fn->args()){
+        if(arg.getType()->isPointerTy()) ids.insert(objIndex.getID(&arg));
+    }
+
+    Point2SetInfo none;
+    SmallVector<unsigned, 4> from;
+    for(inst_iterator ii = inst_begin(*fn), ie = inst_end(*fn); ii != ie; ++ii){
+        LoadInst* loadinst = dyn_cast<LoadInst>(&*ii);
+        if(!loadinst || !loadinst->getType()->isPointerTy()) continue;
+        from.clear();
+        visitor->getPointees(loadinst->getPointerOperand(), none, from);
+        for(unsigned loc : from){
+            if(isInput(fn, objIndex.getObject(loc))) ids.insert(loc);
+        }
+    }
+}
+
+/// Slots whose facts at the call decide what calling @fn does
+const std::vector<unsigned>& CallSummaries::getInputs(Point2AnalysisVisitor* visitor, Function* fn){
+    auto known = inputs.find(fn);
+    if(known != inputs.end()) return known->second;
+
+    DenseSet<unsigned> ids;
+    addInputs(visitor, fn, ids);
+    if(visitor->reportsCalls(fn)){
+        // fn resolves its calls, which reads the call operands, and may
+        // reach any function with a body
+        for(inst_iterator ii = inst_begin(*fn), ie = inst_end(*fn); ii != ie; ++ii){
+            CallInst* callinst = dyn_cast<CallInst>(&*ii);
+            if(!callinst || isa<DbgInfoIntrinsic>(callinst)) continue;
+            for(Value* op : callinst->operands()){
+                if(op->getType()->isPointerTy() && isInput(fn, op))
+                    ids.insert(objIndex.getID(op));
+            }
+        }
+        for(Function &callee : *fn->getParent()){
+            if(!callee.isDeclaration()) addInputs(visitor, &callee, ids);
+        }
+    }
+
+    std::vector<unsigned> &sorted = inputs[fn];
+    sorted.assign(ids.begin(), ids.end());
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
+/// Summary of @fn in @context, or its merged one once the budget is spent
+CallSummaries::Summary& CallSummaries::getSummary(Function* fn, unsigned context){
+    std::map<unsigned, Summary> &sums = table[fn];
+    auto known = sums.find(context);
+    if(known != sums.end()) return known->second;
+
+    if(ContextBudget && numSummaries >= ContextBudget){
+        context = 0;
+        known = sums.find(context);
+        if(known != sums.end()) return known->second;
+    }
+
+    numSummaries++;
+    Summary &sum = sums[context];
+    sum.context = context;
+    return sum;
+}
+
+void CallSummaries::compSummary(Point2AnalysisVisitor* visitor, Function* fn, Summary &sum){
+    myFunc* mfn = ctx->buildMyFunc(*fn);
+    sum.reports |= visitor->reportsCalls(fn);
+
+    unsigned outer = lowest;
+    sum.active = true;
+    sum.depth = solving.size();
+    solving.push_back(&sum);
+    solvingEntry.push_back(mfn->getEntryBlock());
+    std::vector<size_t> marks;
+    for(std::vector<Summary*> &readers : waiting) marks.push_back(readers.size());
+    waiting.emplace_back();
+
+    bool grew;
+    do {
+        // what the last round finished may have read effects that grew
+        for(unsigned d=0;d<marks.size();d++) invalidate(waiting[d], marks[d]);
+        invalidate(waiting.back(), 0);
+        lowest = UINT_MAX;
+        sum.widened = false;
+        DataflowResult<Point2SetInfo>::Type result;
+        Worklist blocks;
+        compForwardDataflow(mfn, blocks, visitor, &result, Point2SetInfo());
+        visits += blocks.getNumVisits();
+        solved++;
+
+        grew = false;
+        // locals of fn die with it, their fields and targets included,
+        // unless the input reaches them: an outer run of a recursive fn
+        // may pass its own to the call
+        PtsSet reachable;
+        sum.input.forEachSlot([&](unsigned, PtsRef set){
+            if(set) reachable |= *set;
+        });
+        result[mfn->getExitBlock()].second.forEachSlot([&](unsigned id, PtsRef set){
+            if(set == sum.input.getSlot(id)) return;
+            // values loaded by fn are dead once it returns
+            Value* obj = objIndex.getObject(id);
+            if(!isInput(fn, obj)) return;
+            AllocaInst* local = dyn_cast<AllocaInst>(obj);
+            if(local && local->getFunction() == fn && !reachable.test(id) &&
+               !reachable.test(objIndex.getID(local))) return;
+
+            PtsRef &effect = sum.effects[id];
+            PtsRef merged = ptsTable.unite(effect, set);
+            if(merged == effect) return;
+            effect = merged;
+            grew = true;
+        });
+        // and what fn returns, at each of its returns
+        for(myBasicBlock* mbb : mfn->mbSet){
+            ReturnInst* retinst = dyn_cast<ReturnInst>(mbb->bb->getTerminator());
+            if(!retinst || mbb->getEndInst() != mbb->bb->end()) continue;
+            Value* retval = retinst->getReturnValue();
+            if(!retval || !retval->getType()->isPointerTy()) continue;
+
+            PtsRef merged = ptsTable.unite(sum.ret, visitor->getPointees(retval, result[mbb].second));
+            if(merged == sum.ret) continue;
+            sum.ret = merged;
+            grew = true;
+        }
+    // a recursive call read the partial effects or widened the input,
+    // solve again with the new ones
+    } while((grew || sum.widened) && lowest <= sum.depth);
+
+    solving.pop_back();
+    solvingEntry.pop_back();
+    sum.active = false;
+    std::vector<Summary*> readers = std::move(waiting.back());
+    waiting.pop_back();
+    // The summaries on a cycle form a strongly connected component, headed
+    // by its shallowest active solve. Its members read partial effects of
+    // the head, so they only hold for the head's current round. They wait
+    // on the head, as on the stack of Tarjan's algorithm, are solved again
+    // when the head starts another round, and are final once it converges.
+    sum.done = true;
+    sum.reads = lowest < sum.depth ? lowest : UINT_MAX;
+    if(sum.reads == UINT_MAX){
+        for(Summary* reader : readers) reader->reads = UINT_MAX;
+        closed += readers.size();
+    }
+    else{
+        std::vector<Summary*> &head = waiting[sum.reads];
+        head.push_back(&sum);
+        for(Summary* reader : readers){
+            reader->reads = sum.reads;
+            head.push_back(reader);
+        }
+    }
+    lowest = std::min(outer, sum.reads);
+}
+
+/// Summary of @fn for @callinst calling it with the facts @in, its input
+/// widened by theirs
+CallSummaries::Summary& CallSummaries::getCallSummary(Point2AnalysisVisitor* visitor, CallInst* callinst,
+                                                      Function* fn, const Point2SetInfo &in){
+    DenseMap<unsigned, PtsRef> bound;
+    for(unsigned i=0;i<callinst->arg_size() && i<fn->arg_size();i++){
+        Value* argi = callinst->getArgOperand(i);
+        if(argi->getType()->isPointerTy())
+            bound[objIndex.getID(fn->getArg(i))] = visitor->getPointees(argi, in);
+    }
+
+    Point2SetInfo input;
+    std::vector<const void*> key;
+    const std::vector<unsigned> &inputs = getInputs(visitor, fn);
+    std::vector<unsigned> reached;
+    DenseSet<unsigned> seen;
+    auto reach = [&](PtsRef set){
+        if(!set) return ;
+        for(unsigned obj : *set){
+            if(seen.insert(obj).second) reached.push_back(obj);
+        }
+    };
+    for(unsigned id : inputs){
+        auto arg = bound.find(id);
+        PtsRef set = arg != bound.end() ? arg->second : in.getSlot(id);
+        key.push_back(set);
+        input.setSlot(id, set);
+        reach(set);
+    }
+
+    // fn may also read whatever its inputs lead to, through any number of
+    // loads: every node reachable from them, and their fields, is an input
+    // of this call too, after the fixed ones and named by its id
+    for(unsigned i=0;i<reached.size();i++){
+        for(unsigned field : objIndex.getChildren(reached[i])){
+            if(seen.insert(field).second) reached.push_back(field);
+        }
+        reach(in.getSlot(reached[i]));
+    }
+    std::sort(reached.begin(), reached.end());
+    for(unsigned id : reached){
+        PtsRef set = in.getSlot(id);
+        if(!set || std::binary_search(inputs.begin(), inputs.end(), id)) continue;
+        key.push_back(reinterpret_cast<const void*>(uintptr_t(id)));
+        key.push_back(set);
+        input.setSlot(id, set);
+    }
+
+    unsigned context;
+    if(CallStringDepth < 0){
+        context = contexts.intern(key);
+        if(!cached.empty()) loadSummary(visitor, fn, input, context);
+    }
+    else{
+        unsigned caller = solving.empty() ? 0 : solving.back()->context;
+        context = contexts.push(caller, callinst, CallStringDepth);
+    }
+
+    Summary &sum = getSummary(fn, context);
+    Point2SetInfo joined = sum.input;
+    joined.unionWith(input);
+    if(!(joined == sum.input)){
+        sum.input = joined;
+        sum.done = false;
+        sum.widened = true;
+    }
+    return sum;
+}
+
+void CallSummaries::prepare(Point2AnalysisVisitor* visitor, CallInst* callinst, ArrayRef<Function*> bodies,
+                            const Point2SetInfo &in){
+    if(ctx->threads <= 1) return ;
+
+    typedef std::vector<ObjectIndex::Path> Paths;
+    struct Task {
+        Function* fn;
+        Summary* sum;
+        std::vector<std::pair<ObjectIndex::Path, Paths> > input, effects;
+        Paths ret, collapsed;
+        unsigned long solved = 0, visits = 0;
+    };
+    auto getPaths = [](PtsRef set){
+        Paths paths;
+        if(set){
+            for(unsigned obj : *set) paths.push_back(objIndex.getPath(obj));
+        }
+        return paths;
+    };
+    auto getSet = [](const Paths &paths){
+        PtsSet set;
+        for(const ObjectIndex::Path &path : paths) set.set(objIndex.getID(path));
+        return ptsTable.intern(set);
+    };
+
+    // up to the first callee that reports calls, whose solve may add
+    // summaries of its own, so that summaries are made in the same order
+    // as by apply() alone
+    std::vector<Task> tasks;
+    for(Function* fn : bodies){
+        if(visitor->reportsCalls(fn)) break;
+        Summary &sum = getCallSummary(visitor, callinst, fn, in);
+        if(sum.done || sum.active) continue;
+
+        tasks.push_back({fn, &sum, {}, {}, {}, {}});
+        sum.input.forEachSlot([&](unsigned id, PtsRef set){
+            tasks.back().input.emplace_back(objIndex.getPath(id), getPaths(set));
+        });
+    }
+    if(tasks.size() < 2) return ;
+    // a job must not overwrite a node that stands for several locations
+    Paths collapsed;
+    for(unsigned id = 0; id < objIndex.size(); id++){
+        if(objIndex.isCollapsed(id)) collapsed.push_back(objIndex.getPath(id));
+    }
+
+    StatsPhase phase(AnalysisStats::Solve);
+    ctx->getPool().forEach(tasks.size(), [&](size_t i){
+        Task &task = tasks[i];
+        // the job may run on the analysis' own thread, whose tables stay
+        // aside until it is done
+        ObjectIndex index;
+        PtsSetTable table;
+        AnalysisStats counters;
+        std::swap(objIndex, index);
+        std::swap(ptsTable, table);
+        std::swap(stats, counters);
+        {
+            TraceJob events;
+            // the layout caches struct layouts without a lock
+            DataLayout layout(*visitor->layout);
+            AnalysisContext own;
+            Point2AnalysisVisitor solver(&own);
+            solver.layout = &layout;
+            solver.singleSites = visitor->singleSites;
+            CallSummaries sums(&own);
+            solver.summaries = &sums;
+
+            for(const ObjectIndex::Path &path : collapsed){
+                objIndex.setCollapsed(objIndex.getID(path));
+            }
+            Summary &sum = sums.getSummary(task.fn, 0);
+            for(auto &slot : task.input){
+                sum.input.setSlot(objIndex.getID(slot.first), getSet(slot.second));
+            }
+            sums.compSummary(&solver, task.fn, sum);
+            for(unsigned id = 0; id < objIndex.size(); id++){
+                if(objIndex.isCollapsed(id)) task.collapsed.push_back(objIndex.getPath(id));
+            }
+            for(auto &effect : sum.effects){
+                if(effect.second) task.effects.emplace_back(objIndex.getPath(effect.first), getPaths(effect.second));
+            }
+            task.ret = getPaths(sum.ret);
+            task.solved = sums.solved;
+            task.visits = sums.visits;
+        }
+        std::swap(objIndex, index);
+        std::swap(ptsTable, table);
+        std::swap(stats, counters);
+        std::lock_guard<std::mutex> guard(totalStatsLock);
+        totalStats.add(counters);
+    });
+
+    for(Task &task : tasks){
+        Summary &sum = *task.sum;
+        for(const ObjectIndex::Path &path : task.collapsed){
+            objIndex.setCollapsed(objIndex.getID(path));
+        }
+        for(auto &effect : task.effects){
+            PtsRef &set = sum.effects[objIndex.getID(effect.first)];
+            set = ptsTable.unite(set, getSet(effect.second));
+        }
+        sum.ret = ptsTable.unite(sum.ret, getSet(task.ret));
+        sum.widened = false;
+        sum.done = true;
+        sum.reads = UINT_MAX;
+        sum.ahead = true;
+        solved += task.solved;
+        visits += task.visits;
+    }
+}
+
+void CallSummaries::apply(Point2AnalysisVisitor* visitor, CallInst* callinst, Function* fn,
+                          const Point2SetInfo &in, Point2SetInfo* out){
+    Summary &sum = getCallSummary(visitor, callinst, fn, in);
+    if(sum.active) lowest = std::min(lowest, sum.depth);
+    else if(!sum.done) compSummary(visitor, fn, sum);
+    else if(sum.ahead) sum.ahead = false;
+    else{
+        reused++;
+        lowest = std::min(lowest, sum.reads);
+    }
+
+    // every enclosing solve now also depends on fn and what fn applied
+    for(Summary* outer : solving){
+        if(outer == &sum) continue;
+        outer->deps.insert(fn);
+        outer->deps.insert(sum.deps.begin(), sum.deps.end());
+        outer->reports |= sum.reports;
+    }
+
+    for(auto &effect : sum.effects){
+        out->setSlot(effect.first, ptsTable.unite(out->getSlot(effect.first), effect.second));
+    }
+    if(sum.ret){
+        unsigned result = objIndex.getID(callinst);
+        out->setSlot(result, ptsTable.unite(out->getSlot(result), sum.ret));
+    }
+}
+
+/// Name of the node @id in a summary of @fn, the same in every run. The
+/// objects of fn's callers, which edits to them renumber, are named by
+/// the order the input reaches them instead, "$0", "$1" and so on, and
+/// @callers holds their ids in that order; only the input, with @bind
+/// set, adds to it. Such a node a store does not overwrite is marked by a
+/// "~", as the summary may differ for one it does.
+bool CallSummaries::nameNode(Point2AnalysisVisitor* visitor, Function* fn, unsigned id,
+                             std::vector<unsigned> &callers, bool bind, std::string &name){
+    Value* obj = objIndex.getObject(id);
+    StringRef value = names->getName(obj);
+    if(value.empty()) return false;
+    StringRef owner = StableNames::getOwner(value);
+    if(owner.empty() || owner == fn->getName()){
+        name = objIndex.getName(id, value);
+        return true;
+    }
+
+    unsigned root = objIndex.getID(obj);
+    auto bound = std::find(callers.begin(), callers.end(), root);
+    if(bound == callers.end()){
+        if(!bind) return false;
+        bound = callers.insert(callers.end(), root);
+    }
+    name = objIndex.getName(id, "$" + std::to_string(bound - callers.begin()));
+    if(!visitor->isStrongUpdate(id)) name += "~";
+    return true;
+}
+
+bool CallSummaries::nameFacts(Point2AnalysisVisitor* visitor, Function* fn, unsigned id, PtsRef set,
+                              std::vector<unsigned> &callers, bool bind, CachedSummary::Facts &facts){
+    std::string slot;
+    if(!nameNode(visitor, fn, id, callers, bind, slot)) return false;
+    facts.emplace_back(slot, std::vector<std::string>());
+    for(unsigned obj : *set){
+        std::string fact;
+        if(!nameNode(visitor, fn, obj, callers, bind, fact)) return false;
+        facts.back().second.push_back(fact);
+    }
+    return true;
+}
+
+/// Key of a named input, as the cache stores it
+std::string CallSummaries::getInputKey(const CachedSummary::Facts &input){
+    std::string key;
+    for(auto &slot : input){
+        key += slot.first;
+        for(const std::string &fact : slot.second) key += "\t" + fact;
+        key += "\n";
+    }
+    return key;
+}
+
+void CallSummaries::exportTo(AnalysisCache &cache, const StableNames &names, Point2AnalysisVisitor* visitor){
+    this->names = &names;
+    for(auto &sums : table){
+        Function* fn = sums.first;
+        for(auto &entry : sums.second){
+            const Summary &sum = entry.second;
+            if(!sum.done || sum.reports) continue;
+
+            CachedSummary cached;
+            std::vector<unsigned> callers;
+            bool named = true;
+            sum.input.forEachSlot([&](unsigned id, PtsRef set){
+                if(named) named = nameFacts(visitor, fn, id, set, callers, true, cached.input);
+            });
+            // sorted, so that the file does not depend on hashing order
+            std::map<unsigned, PtsRef> effects(sum.effects.begin(), sum.effects.end());
+            for(auto &effect : effects){
+                if(named && effect.second)
+                    named = nameFacts(visitor, fn, effect.first, effect.second, callers, false, cached.effects);
+            }
+            if(named && sum.ret){
+                for(unsigned obj : *sum.ret){
+                    cached.ret.emplace_back();
+                    if(!(named = nameNode(visitor, fn, obj, callers, false, cached.ret.back()))) break;
+                }
+            }
+            if(!named) continue;
+
+            // the names above only depend on fn, and those of what it calls
+            std::set<std::string> deps{fn->getName().str()};
+            for(Function* dep : sum.deps) deps.insert(dep->getName().str());
+            cached.deps.assign(deps.begin(), deps.end());
+            cache.addSummary(fn->getName(), std::move(cached));
+        }
+    }
+}
+
+void CallSummaries::importFrom(Module &M, const AnalysisCache &cache, const StableNames &names,
+                               Point2AnalysisVisitor* visitor){
+    this->names = &names;
+    for(Function &fn : M){
+        if(fn.isDeclaration()) continue;
+        if(visitor->seed && !visitor->seed->isReachable(&fn)) continue;
+
+        for(const CachedSummary* sum : cache.getSummaries(fn.getName())){
+            cached[&fn].insert({getInputKey(sum->input), *sum});
+        }
+    }
+}
+
+/// Make the summary of the last run for @fn called with @input that of
+/// @context, if there is one. The objects of the caller it names are
+/// bound to those of this call.
+void CallSummaries::loadSummary(Point2AnalysisVisitor* visitor, Function* fn, const Point2SetInfo &input,
+                                unsigned context){
+    auto sums = cached.find(fn);
+    if(sums == cached.end() || table[fn].count(context)) return;
+
+    CachedSummary::Facts named;
+    std::vector<unsigned> callers;
+    bool found = true;
+    input.forEachSlot([&](unsigned id, PtsRef set){
+        if(found) found = nameFacts(visitor, fn, id, set, callers, true, named);
+    });
+    auto hit = found ? sums->second.find(getInputKey(named)) : sums->second.end();
+    if(hit == sums->second.end()) return;
+    const CachedSummary &old = hit->second;
+
+    auto lookup = [&](StringRef name) -> Value* {
+        unsigned k;
+        if(!name.consume_front("$")) return names->getValue(name);
+        return !name.getAsInteger(10, k) && k < callers.size() ? objIndex.getObject(callers[k]) : nullptr;
+    };
+    auto readSet = [&](const std::vector<std::string> &facts, PtsRef &set){
+        PtsSet objs;
+        for(const std::string &fact : facts){
+            unsigned obj;
+            if(!objIndex.parseName(StringRef(fact).rtrim('~'), lookup, obj)) return false;
+            objs.set(obj);
+        }
+        set = ptsTable.intern(objs);
+        return true;
+    };
+    DenseMap<unsigned, PtsRef> effects;
+    for(auto &slot : old.effects){
+        unsigned id;
+        if(!objIndex.parseName(StringRef(slot.first).rtrim('~'), lookup, id) ||
+           !readSet(slot.second, effects[id])) return ;
+    }
+    PtsRef ret = nullptr;
+    if(!old.ret.empty() && !readSet(old.ret, ret)) return ;
+    DenseSet<Function*> deps;
+    for(const std::string &dep : old.deps){
+        Function* f = dyn_cast_or_null<Function>(names->getValue("@" + dep));
+        if(!f) return ;
+        deps.insert(f);
+    }
+
+    loaded++;
+    Summary &sum = getSummary(fn, context);
+    sum.input = input;
+    sum.effects = std::move(effects);
+    sum.ret = ret;
+    sum.deps = std::move(deps);
+    sum.done = true;
+}
+
+static cl::opt<bool> SparseMode("sparse",
+    cl::desc("Propagate points-to facts along def-use chains instead of through every block"),
+    cl::init(false));
+
+static cl::opt<unsigned> Threads("threads",
+    cl::desc("Number of threads building per-function CFGs (default: one per core)"),
+    cl::init(std::thread::hardware_concurrency()));
+
+static cl::opt<std::string> EntryName("entry",
+    cl::desc("Root function of a multi-file program (default: the last function with a body in the last file)"),
+    cl::init(""));
+
+static cl::opt<std::string> CacheFile("cache",
+    cl::desc("Reuse the results of the last run from this file where the module did not change, and update it"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> ResultFile("results",
+    cl::desc("Also write the result to this file in the binary format of ResultStore.h"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<bool> SteensSeed("steens-seed",
+    cl::desc("Resolve calls with a unification pre-pass first and only build and wire in its callees"),
+    cl::init(false));
+
+///
+/// Def-use chains of memory over the spliced CFG, kept apart per
+/// partition of memory. The partitions are the storage classes of the
+/// unification pre-pass, so every node a load or a store may touch is in
+/// the partition of its pointer. Stores, and allocation sites copying
+/// what their argument points to, define their partition; loads, and
+/// those sites for their argument, use one. A def reaches every access to
+/// its partition that it has a path to crossing no other def of it.
+/// Callees are added as they get spliced in, and a def that reached the
+/// end of a block follows the edges added there later, so the chains
+/// only ever grow.
+///
+class MemoryDefUse {
+public:
+    struct Access {
+        Instruction* inst;
+        unsigned part;
+        bool def;
+        SmallVector<unsigned, 2> reaching;   /// defs that reach this access
+        SmallVector<unsigned, 2> users;      /// accesses this def reaches
+    };
+
+private:
+    SteensgaardSolver* partitions;
+    std::vector<Access> accesses;
+    DenseMap<Instruction*, std::pair<unsigned, unsigned> > accessesOf;   /// inst -> [first, last) access
+    DenseMap<myBasicBlock*, std::vector<unsigned> > blockAccesses;       /// block -> its accesses in order
+    /// A def on its way through a block, from its access @from on
+    struct Walk {
+        unsigned def;
+        myBasicBlock* mbb;
+        unsigned from;
+        myBasicBlock* ret;    /// where the callee it is in returns to, null if to every caller
+    };
+    DenseMap<myBasicBlock*, std::vector<std::pair<unsigned, myBasicBlock*> > > liveOut;   /// block -> (def, ret) reaching its end
+    DenseSet<std::pair<std::pair<unsigned, myBasicBlock*>, myBasicBlock*> > entered;    /// ((def, block), ret) walked
+    std::vector<Instruction*> linked;     /// accesses that gained a reaching def since the last take
+    DenseMap<myFunc*, DenseSet<unsigned> > partsOf;   /// partitions a leaf callee accesses
+
+    void addAccess(myBasicBlock* mbb, Instruction* inst, Value* ptr, bool def){
+        unsigned id = accesses.size();
+        accesses.push_back({inst, partitions->getPartition(ptr), def, {}, {}});
+        auto leaf = partsOf.find(mbb->parent);
+        if(leaf != partsOf.end()) leaf->second.insert(accesses.back().part);
+        blockAccesses[mbb].push_back(id);
+        auto found = accessesOf.insert({inst, {id, id + 1}});
+        if(!found.second) found.first->second.second = id + 1;
+    }
+
+    void link(unsigned def, unsigned use){
+        accesses[def].users.push_back(use);
+        accesses[use].reaching.push_back(def);
+        linked.push_back(accesses[use].inst);
+    }
+
+    /// Whether @to is the entry of a callee of the call that ends @from
+    static bool isCallEdge(myBasicBlock* from, myBasicBlock* to){
+        if(to != to->parent->getEntryBlock() || from->getBeginInst() == from->getEndInst()) return false;
+        return isa<CallInst>(*std::prev(from->getEndInst()));
+    }
+
+    /// Let @def, which reaches the end of @from on its way back to @ret
+    /// (null: to every caller), go on to @to. A callee returns only to
+    /// the call it was entered from.
+    void follow(unsigned def, myBasicBlock* from, myBasicBlock* to, myBasicBlock* ret,
+                std::vector<Walk> &stack){
+        if(from->isExitBlock && ret){
+            if(to != ret) return ;
+            ret = nullptr;
+        }
+        if(isCallEdge(from, to)){
+            // a leaf that leaves the partition alone is bypassed by the
+            // edge to the return block
+            auto leaf = partsOf.find(to->parent);
+            if(leaf != partsOf.end() && !leaf->second.count(accesses[def].part)) return ;
+            CallInst* callinst = cast<CallInst>(&*std::prev(from->getEndInst()));
+            ret = Point2AnalysisVisitor::getReturnBlock(callinst, from);
+        }
+        if(entered.insert({{def, to}, ret}).second) stack.push_back({def, to, 0, ret});
+    }
+
+    /// Follow the defs on @stack on, until other defs of their partition
+    /// block every path
+    void walk(std::vector<Walk> &stack){
+        while(!stack.empty()){
+            Walk w = stack.back();
+            stack.pop_back();
+            unsigned part = accesses[w.def].part;
+
+            bool killed = false;
+            auto list = blockAccesses.find(w.mbb);
+            if(list != blockAccesses.end()){
+                for(unsigned i=w.from;i<list->second.size() && !killed;i++){
+                    unsigned id = list->second[i];
+                    if(accesses[id].part != part) continue;
+                    link(w.def, id);
+                    killed = accesses[id].def;
+                }
+            }
+            if(killed) continue;
+
+            liveOut[w.mbb].push_back({w.def, w.ret});
+            for(myBasicBlock* succ : w.mbb->getSuccs()){
+                follow(w.def, w.mbb, succ, w.ret, stack);
+            }
+        }
+    }
+
+public:
+    explicit MemoryDefUse(SteensgaardSolver* p) : partitions(p) {}
+
+    /// Add the accesses of @mfn, which has just been built, and the
+    /// chains of its defs. A leaf has no calls that get spliced in.
+    void addFunction(myFunc* mfn, bool leaf){
+        std::vector<std::pair<unsigned, myBasicBlock*> > defs;
+        if(leaf) partsOf[mfn];
+        for(myBasicBlock* mbb : mfn->mbSet){
+            for(BasicBlock::iterator ii = mbb->getBeginInst(), ie = mbb->getEndInst(); ii != ie; ++ii){
+                Instruction* inst = &*ii;
+                if(LoadInst* loadinst = dyn_cast<LoadInst>(inst)){
+                    if(loadinst->getType()->isPointerTy())
+                        addAccess(mbb, loadinst, loadinst->getPointerOperand(), false);
+                }
+                else if(StoreInst* storeinst = dyn_cast<StoreInst>(inst)){
+                    if(!storeinst->getValueOperand()->getType()->isPointerTy()) continue;
+                    addAccess(mbb, storeinst, storeinst->getPointerOperand(), true);
+                    defs.push_back({accesses.size() - 1, mbb});
+                }
+                else if(CallInst* callinst = dyn_cast<CallInst>(inst)){
+                    if(!objIndex.isHeap(callinst) || !callinst->arg_size()) continue;
+                    Value* from = callinst->getArgOperand(0);
+                    if(!from->getType()->isPointerTy()) continue;
+                    addAccess(mbb, callinst, from, false);
+                    addAccess(mbb, callinst, callinst, true);
+                    defs.push_back({accesses.size() - 1, mbb});
+                }
+            }
+        }
+
+        std::vector<Walk> stack;
+        for(auto &def : defs){
+            const std::vector<unsigned> &list = blockAccesses[def.second];
+            unsigned at = std::find(list.begin(), list.end(), def.first) - list.begin();
+            stack.push_back({def.first, def.second, at + 1, nullptr});
+        }
+        walk(stack);
+    }
+
+    /// Let the defs that reach the end of @from follow its new edge to @to
+    void addEdge(myBasicBlock* from, myBasicBlock* to){
+        auto live = liveOut.find(from);
+        if(live == liveOut.end()) return ;
+        std::vector<std::pair<unsigned, myBasicBlock*> > defs = live->second;
+        std::vector<Walk> stack;
+        for(auto &def : defs){
+            follow(def.first, from, to, def.second, stack);
+        }
+        walk(stack);
+    }
+
+    /// Instructions with accesses that gained a reaching def since the
+    /// last call
+    std::vector<Instruction*> takeLinked(){
+        std::vector<Instruction*> taken;
+        taken.swap(linked);
+        return taken;
+    }
+
+    /// Accesses of @inst, as a range of ids
+    std::pair<unsigned, unsigned> getAccesses(Instruction* inst) const {
+        auto found = accessesOf.find(inst);
+        return found == accessesOf.end() ? std::make_pair(0u, 0u) : found->second;
+    }
+
+    const Access& getAccess(unsigned id) const {
+        return accesses[id];
+    }
+
+    unsigned size() const {
+        return accesses.size();
+    }
+};
+
+///
+/// Sparse points-to solver. Every pointer value has a single fact, valid
+/// wherever the value is defined, and facts only travel along def-use
+/// chains: loads, arguments and call results reach their users through
+/// the LLVM use lists, and what stores write reaches loads through the
+/// chains of MemoryDefUse. Each def keeps the facts of the nodes of its
+/// partition after it. Call targets are resolved with the visitor, and
+/// every new callee spliced into the CFG extends the chains.
+///
+class SparsePoint2Solver {
+    typedef DenseMap<unsigned, PtsRef> MemoryFacts;
+
+    Point2AnalysisVisitor* visitor;
+    Function* root;
+    Point2SetInfo pts;
+    MemoryDefUse memory;
+    std::vector<MemoryFacts> defFacts;              /// access id -> facts after it, for defs
+    DenseSet<Function*> added;                      /// functions whose CFGs the chains cover
+    DenseMap<CallInst*, myBasicBlock*> callBlock;
+    DenseMap<Function*, SmallVector<CallInst*, 4> > callers;   /// callee -> resolved calls its returns reach
+
+    std::vector<Instruction*> ordered;           /// position -> instruction
+    DenseMap<Instruction*, unsigned> position;   /// instructions of the added CFGs, each in reverse post-order
+    BitVector pending;
+    int last = -1;                               /// position popped last
+
+    void enqueue(Instruction* inst){
+        // instructions outside the spliced CFG are queued once it gets there
+        auto found = position.find(inst);
+        if(found != position.end()) pending.set(found->second);
+    }
+
+    /// Next queued instruction, sweeping forward from the last one as the
+    /// dense worklist does, so defs tend to go before their uses
+    Instruction* pop(){
+        int next = last < 0 ? pending.find_first() : pending.find_next(last);
+        if(next < 0) next = pending.find_first();
+        pending.reset(next);
+        last = next;
+        return ordered[next];
+    }
+
+    /// Queue what reads the facts of @v, looking through the casts, GEPs,
+    /// phis and selects that getPointees looks through
+    void enqueueUsers(Value* v){
+        SmallVector<Value*, 8> values{v};
+        SmallPtrSet<Value*, 8> seen{v};
+        while(!values.empty()){
+            Value* value = values.pop_back_val();
+            for(User* user : value->users()){
+                Instruction* inst = dyn_cast<Instruction>(user);
+                if(!inst) continue;
+                if(isa<GetElementPtrInst>(inst) || isa<CastInst>(inst) ||
+                   isa<PHINode>(inst) || isa<SelectInst>(inst)){
+                    if(seen.insert(inst).second) values.push_back(inst);
+                }
+                else if(isa<LoadInst>(inst) || isa<StoreInst>(inst) || isa<CallInst>(inst)){
+                    enqueue(inst);
+                }
+                else if(isa<ReturnInst>(inst)){
+                    for(CallInst* callinst : callers.lookup(inst->getFunction())) enqueue(callinst);
+                }
+            }
+        }
+    }
+
+    /// Blocks of @mfn in reverse post-order of its own edges
+    static std::vector<myBasicBlock*> getBlockOrder(myFunc* mfn){
+        std::vector<myBasicBlock*> postorder;
+        DenseSet<myBasicBlock*> visited{mfn->getEntryBlock()};
+        std::vector<std::pair<myBasicBlock*, unsigned> > stack{{mfn->getEntryBlock(), 0}};
+        while(!stack.empty()){
+            myBasicBlock* mbb = stack.back().first;
+            if(stack.back().second == mbb->getSuccs().size()){
+                postorder.push_back(mbb);
+                stack.pop_back();
+                continue;
+            }
+            myBasicBlock* succ = mbb->getSuccs()[stack.back().second++];
+            if(succ->parent == mfn && visited.insert(succ).second) stack.push_back({succ, 0});
+        }
+        std::reverse(postorder.begin(), postorder.end());
+        return postorder;
+    }
+
+    /// Add the accesses and calls of the CFG of @fn, once
+    void addFunction(Function* fn){
+        if(!added.insert(fn).second) return ;
+        myFunc* mfn = visitor->ctx->getMyFunc(fn);
+        memory.addFunction(mfn, !visitor->reportsCalls(fn));
+        defFacts.resize(memory.size());
+        for(myBasicBlock* mbb : getBlockOrder(mfn)){
+            for(BasicBlock::iterator ii = mbb->getBeginInst(), ie = mbb->getEndInst(); ii != ie; ++ii){
+                Instruction* inst = &*ii;
+                CallInst* callinst = dyn_cast<CallInst>(inst);
+                if(callinst && isa<DbgInfoIntrinsic>(callinst)) continue;
+                if(!callinst && !memory.getAccesses(inst).second) continue;
+
+                if(callinst) callBlock[callinst] = mbb;
+                position.insert({inst, ordered.size()});
+                ordered.push_back(inst);
+                pending.resize(ordered.size());
+                enqueue(inst);
+            }
+        }
+    }
+
+    void enqueueLinked(){
+        for(Instruction* inst : memory.takeLinked()) enqueue(inst);
+    }
+
+    /// Facts the defs reaching access @id leave in memory
+    MemoryFacts getReaching(unsigned id){
+        MemoryFacts in;
+        for(unsigned def : memory.getAccess(id).reaching){
+            for(auto &fact : defFacts[def]){
+                PtsRef &set = in[fact.first];
+                set = ptsTable.unite(set, fact.second);
+            }
+        }
+        return in;
+    }
+
+    /// Make @facts what def @id leaves, and queue its users if that
+    /// changed. Like a block's transfer in the dense solve, a def is
+    /// applied to its current input each time, so a store that wrote
+    /// through a pointer before its facts arrived does not keep the stale
+    /// write.
+    void updateDef(unsigned id, MemoryFacts &&facts){
+        MemoryFacts &out = defFacts[id];
+        bool same = out.size() == facts.size();
+        for(auto fact = facts.begin(); same && fact != facts.end(); ++fact){
+            auto old = out.find(fact->first);
+            same = old != out.end() && old->second == fact->second;
+        }
+        if(same) return ;
+        out = std::move(facts);
+        for(unsigned user : memory.getAccess(id).users){
+            enqueue(memory.getAccess(user).inst);
+        }
+    }
+
+    void processLoad(LoadInst* loadinst, unsigned id){
+        SmallVector<unsigned, 4> from;
+        visitor->getPointees(loadinst->getPointerOperand(), pts, from);
+        PtsRef loaded = nullptr;
+        for(unsigned def : memory.getAccess(id).reaching){
+            const MemoryFacts &out = defFacts[def];
+            for(unsigned loc : from){
+                auto fact = out.find(loc);
+                if(fact != out.end()) loaded = ptsTable.unite(loaded, fact->second);
+            }
+        }
+
+        unsigned value = objIndex.getID(loadinst);
+        PtsRef merged = ptsTable.unite(pts.getSlot(value), loaded);
+        if(merged == pts.getSlot(value)) return ;
+        pts.setSlot(value, merged);
+        enqueueUsers(loadinst);
+    }
+
+    /// As Point2AnalysisVisitor::handleStoreInst, over the facts of the
+    /// partition
+    void processStore(StoreInst* storeinst, unsigned id){
+        MemoryFacts out = getReaching(id);
+        SmallVector<unsigned, 4> to;
+        visitor->getPointees(storeinst->getPointerOperand(), pts, to);
+        PtsRef stored = visitor->getPointees(storeinst->getValueOperand(), pts);
+        if(visitor->isStrongUpdate(to)){
+            out[to[0]] = stored;
+        }
+        else{
+            for(unsigned loc : to){
+                PtsRef &set = out[loc];
+                set = ptsTable.unite(set, stored);
+            }
+        }
+        updateDef(id, std::move(out));
+    }
+
+    /// As Point2AnalysisVisitor::handleAllocation, reading what the
+    /// argument points to through the use access @use
+    void processAllocation(CallInst* callinst, unsigned use, unsigned id){
+        MemoryFacts out = getReaching(id);
+        MemoryFacts from = getReaching(use);
+        unsigned site = objIndex.getID(callinst);
+        auto copy = [&](unsigned src, unsigned dst){
+            auto fact = from.find(src);
+            if(fact == from.end()) return ;
+            PtsRef &set = out[dst];
+            set = ptsTable.unite(set, fact->second);
+        };
+
+        SmallVector<unsigned, 4> objs;
+        visitor->getPointees(callinst->getArgOperand(0), pts, objs);
+        for(unsigned obj : objs){
+            if(obj == site) continue;
+            copy(obj, site);
+            for(unsigned field : objIndex.getChildren(obj)){
+                unsigned parent;
+                uint64_t offset;
+                objIndex.getDerived(field, parent, offset);
+                if(offset == ObjectIndex::Target) continue;
+                copy(field, objIndex.getFieldID(site, offset));
+            }
+        }
+        updateDef(id, std::move(out));
+    }
+
+    /// What @fn returns, joined over its returns
+    PtsRef getReturned(Function* fn){
+        PtsRef returned = nullptr;
+        for(BasicBlock &bb : *fn){
+            ReturnInst* retinst = dyn_cast<ReturnInst>(bb.getTerminator());
+            if(!retinst || !retinst->getReturnValue() || !retinst->getReturnValue()->getType()->isPointerTy())
+                continue;
+            returned = ptsTable.unite(returned, visitor->getPointees(retinst->getReturnValue(), pts));
+        }
+        return returned;
+    }
+
+    void processCall(CallInst* callinst){
+        LineCallees* names = visitor->getCallOutput(callinst);
+        if(!names) return ;
+
+        if(Function* alloc = getAllocator(callinst)){
+            names->insert(alloc);
+            return ;
+        }
+
+        myBasicBlock* curBB = callBlock[callinst];
+        PtsRef returned = nullptr;
+        for(unsigned funcid : visitor->getCallees(callinst, pts)){
+            Function* f = dyn_cast<Function>(objIndex.getObject(funcid));
+            if(!f) continue;
+
+            unsigned known = visitor->callGraph.getNumCalls();
+            if(!visitor->addCallee(callinst, f, names, curBB)) continue;
+            if(f->isDeclaration()) continue;
+
+            // the callee was just spliced in: extend the chains over it
+            if(visitor->callGraph.getNumCalls() != known){
+                myFunc* mfn = visitor->ctx->getMyFunc(f);
+                addFunction(f);
+                memory.addEdge(curBB, mfn->getEntryBlock());
+                memory.addEdge(mfn->getExitBlock(), Point2AnalysisVisitor::getReturnBlock(callinst, curBB));
+                enqueueLinked();
+                callers[f].push_back(callinst);
+            }
+
+            for(unsigned i=0;i<callinst->arg_size() && i<f->arg_size();i++){
+                Value* argi = callinst->getArgOperand(i);
+                if(!argi->getType()->isPointerTy()) continue;
+                unsigned farg = objIndex.getID(f->getArg(i));
+                PtsRef merged = ptsTable.unite(pts.getSlot(farg), visitor->getPointees(argi, pts));
+                if(merged == pts.getSlot(farg)) continue;
+                pts.setSlot(farg, merged);
+                enqueueUsers(f->getArg(i));
+            }
+            returned = ptsTable.unite(returned, getReturned(f));
+        }
+
+        unsigned result = objIndex.getID(callinst);
+        PtsRef merged = ptsTable.unite(pts.getSlot(result), returned);
+        if(merged == pts.getSlot(result)) return ;
+        pts.setSlot(result, merged);
+        enqueueUsers(callinst);
+    }
+
+    void process(Instruction* inst){
+        std::pair<unsigned, unsigned> ids = memory.getAccesses(inst);
+        if(LoadInst* loadinst = dyn_cast<LoadInst>(inst)){
+            if(ids.first != ids.second) processLoad(loadinst, ids.first);
+        }
+        else if(StoreInst* storeinst = dyn_cast<StoreInst>(inst)){
+            if(ids.first != ids.second) processStore(storeinst, ids.first);
+        }
+        else if(CallInst* callinst = dyn_cast<CallInst>(inst)){
+            if(ids.first != ids.second) processAllocation(callinst, ids.first, ids.first + 1);
+            if(callBlock.count(callinst)) processCall(callinst);
+        }
+    }
+
+public:
+    SparsePoint2Solver(Point2AnalysisVisitor* v, Function* fn, SteensgaardSolver* partitions)
+        : visitor(v), root(fn), memory(partitions) {}
+
+    void solve(){
+        visitor->ctx->buildMyFunc(*root);
+        addFunction(root);
+        enqueueLinked();
+
+        while(pending.any()){
+            process(pop());
+        }
+    }
+};
+
 
 class PointAnalysis : public ModulePass {
 public:
 
     static char ID;
-    PointAnalysis() : ModulePass(ID) {} 
+    raw_ostream &out;     /// where the result goes
+    PointAnalysis() : ModulePass(ID), out(errs()) {} 
+    explicit PointAnalysis(raw_ostream &o) : ModulePass(ID), out(o) {}
     
     
-    BasicBlock::iterator getFirstInst(BasicBlock* bb){
-        return bb->begin();
-    } 
+    /// Write the reported calls and the per-block states of @result to
+    /// @path. Objects are named as in StableNames, so instructions are
+    /// numbered as there too.
+    bool writeResults(StringRef path, const StableNames &names, Point2AnalysisVisitor &visitor,
+                      const DataflowResult<Point2SetInfo>::Type &result){
+        ResultStoreWriter store;
+        for(unsigned id=0;id<objIndex.size();id++){
+            Value* v = objIndex.getObject(id);
+            StringRef name = names.getName(v);
+            store.addObject(objIndex.getName(id, name.empty() ? v->getName() : name));
+        }
+
+        DenseMap<PtsRef, unsigned> sets;
+        auto getState = [&](const Point2SetInfo &info){
+            std::vector<std::pair<unsigned, unsigned> > state;
+            info.forEachSlot([&](unsigned id, PtsRef set){
+                auto known = sets.find(set);
+                if(known == sets.end()){
+                    std::vector<unsigned> ids;
+                    for(unsigned obj : *set) ids.push_back(obj);
+                    known = sets.insert({set, store.addSet(ids)}).first;
+                }
+                state.push_back({id, known->second});
+            });
+            return state;
+        };
 
-    BasicBlock::iterator getLastInst(BasicBlock* bb){
-        return bb->end();
-    }
-
-    void preProcess(Module &M) {
-        for(Function &fn:M){
-            if(fn.isIntrinsic()) continue;
-            myFunc* mf = new myFunc(&fn);
-            func2myfunc.insert({&fn,mf});
-
-            BasicBlock* begin_block =  &(fn.getEntryBlock());
-            myBasicBlock* begin_mbb = new myBasicBlock(begin_block,mf);
-            begin_mbb->setBeginInst(getFirstInst(begin_block));
-            begin_mbb->setEndInst(getLastInst(begin_block));
-            
-            mf->addmyBasicBlock(begin_mbb);
-            mf->setEntryBlock(begin_mbb); 
-            
-            std::map<BasicBlock*,myBasicBlock*> createdList;
-            std::set<BasicBlock*> blist;
-            createdList.insert({begin_block,begin_mbb});
-            blist.insert(begin_block); 
-             
-
-            while(!blist.empty()){
-                BasicBlock* block = *blist.begin();
-                blist.erase(blist.begin());
-                myBasicBlock* pre_mbb = createdList[block];
-
-                for(auto si = succ_begin(block), se = succ_end(block); si!=se; si++){
-                    BasicBlock* succb = *si;
-                    myBasicBlock* succ_mbb;  
-
-                    if(createdList.find(succb)==createdList.end()){
-                        succ_mbb = new myBasicBlock(succb,mf);
-                        succ_mbb->setBeginInst(getFirstInst(succb));
-                        succ_mbb->setEndInst(getLastInst(succb));
-                        
-                        mf->addmyBasicBlock(succ_mbb);
-                        createdList.insert({succb,succ_mbb});
-                        blist.insert(succb);                         
-                    }
-                    else{
-                        succ_mbb = createdList[succb];
-                    }
-                    
-                    pre_mbb->addSucc(succ_mbb); 
-                    
-                }                
-            }
-
-            mf->setExitBlock(createdList[&(fn.back())]);
-            mf->getExitBlock()->isExitBlock = 1;
-            for(Function::iterator bi = fn.begin(), be = fn.end();bi != be; bi++){
-                BasicBlock* bb = &*bi;
-                
-                for (BasicBlock::iterator ii=bb->begin(), ie=bb->end(); ii!=ie; ++ii){
-                    Instruction* inst = &*ii;
-                    if(isa<DbgInfoIntrinsic>(inst)) continue; 
-                    if(CallInst* callinst = dyn_cast<CallInst>(inst)){
-                        if(callinst->getCalledOperand()->getName()!="malloc"){
-                            myBasicBlock* mbb = createdList[bb];
-                            auto tmpi = ii;
-                            tmpi++;
-                            createdList[bb] =  mbb->split(tmpi);
-                        } 
-                    }
+        DenseMap<Instruction*, unsigned> instIndex;
+        for(auto &block : result){
+            myBasicBlock* mbb = block.first;
+            if(!mbb) continue;
+            Function* fn = mbb->parent->mf;
+            if(instIndex.empty() || !instIndex.count(&fn->getEntryBlock().front())){
+                unsigned index = 0;
+                for(inst_iterator ii = inst_begin(*fn), ie = inst_end(*fn); ii != ie; ++ii){
+                    instIndex[&*ii] = index++;
                 }
-            } 
-             
+            }
+            // a block that starts at the end of its BasicBlock is empty
+            unsigned first = mbb->begin_inst != mbb->bb->end() ? instIndex[&*mbb->begin_inst]
+                                                                : instIndex[&mbb->bb->back()] + 1;
+            unsigned count = std::distance(mbb->begin_inst, mbb->end_inst);
+            store.addBlock(fn->getName(), first, count, getState(block.second.first), getState(block.second.second));
         }
+
+        visitor.mOutput.forEachLine([&](unsigned line, ArrayRef<StringRef> callees){
+            store.addLine(line, callees);
+        });
+        return store.write(path);
     }
 
     bool runOnModule(Module &M) override {
@@ -337,21 +1888,145 @@ public:
         // call inst in previous block. A empty block will be created, and its succ is the second block, its
         // pred is the first block.
         
-        preProcess(M); 
-        
-        DataflowResult<Point2SetInfo>::Type result;
-        Point2AnalysisVisitor visitor;
-        Point2SetInfo initval;
+        objIndex.clear();
+        objIndex.numberModule(M);
+        ptsTable.clear();
+
         auto f = M.rbegin(), e = M.rend();
         for(;(f->isIntrinsic()|| f->size()==0)&&f!=e;f++){
         }
+
+        // the report is that of the root, so a module whose functions
+        // moved around is another program
+        StableNames names;
+        AnalysisCache cache("root=" + f->getName().str() +
+                            " entry=" + EntryName +
+                            " sparse=" + std::to_string(SparseMode) +
+                            " steens-seed=" + std::to_string(SteensSeed) +
+                            " kcfa=" + std::to_string(CallStringDepth) +
+                            " context-budget=" + std::to_string(ContextBudget) +
+                            " field-limit=" + std::to_string(FieldLimit) +
+                            " allocators=" + join(ExtraAllocators, ","));
+        if(!CacheFile.empty() || !ResultFile.empty()) names.numberModule(M);
+        if(!CacheFile.empty()){
+            StatsPhase phase(AnalysisStats::CacheIO);
+            cache.fingerprintModule(M, names);
+            // a hit has no per-block states or call graph to write out
+            if(cache.load(CacheFile) && cache.isModuleUnchanged() && ResultFile.empty() && CallGraphFile.empty()){
+                StatsPhase output(AnalysisStats::Output);
+                out << cache.getReport();
+                objIndex.clear();
+                return false;
+            }
+        }
+
+        AnalysisContext ctx;
+        ctx.threads = Threads;
+        DataflowResult<Point2SetInfo>::Type result;
+        Point2AnalysisVisitor visitor(&ctx);
+        visitor.layout = &M.getDataLayout();
+        Point2SetInfo initval;
+        visitor.findSingleSites(&*f);
+
+        SteensgaardSolver seed;
+        if(SteensSeed){
+            seed.solve(M);
+            seed.compReachable(&*f);
+            visitor.seed = &seed;
+        }
         
-        compForwardDataflow(&*f, &visitor, &result, initval);
-        visitor.showResult();
+        if(SparseMode){
+            // the sparse chains are split by the classes of the pre-pass
+            if(!SteensSeed) seed.solve(M);
+            StatsPhase phase(AnalysisStats::Solve);
+            SparsePoint2Solver solver(&visitor, &*f, &seed);
+            solver.solve();
+        }
+        else{
+            CallSummaries summaries(&ctx);
+            visitor.summaries = &summaries;
+            // summaries keyed by call strings or merged over the budget
+            // depend on the order they were made in, so only input-keyed
+            // ones carry over
+            bool reusable = !CacheFile.empty() && CallStringDepth < 0 && !ContextBudget;
+            if(reusable) summaries.importFrom(M, cache, names, &visitor);
+            compForwardDataflow(ctx, &*f, &visitor, &result, initval);
+            if(ShowVisits){
+                errs() << "summaries: " << summaries.getNumSummaries() << " in "
+                       << summaries.getNumContexts() << " contexts, "
+                       << summaries.solved << " solved, "
+                       << summaries.reused << " reused, "
+                       << summaries.loaded << " loaded, "
+                       << summaries.closed << " closed with their cycle, "
+                       << summaries.visits << " visits\n";
+            }
+            if(reusable) summaries.exportTo(cache, names, &visitor);
+            visitor.summaries = nullptr;
+        }
+        {
+            StatsPhase phase(AnalysisStats::Output);
+            visitor.printResult(out);
+            if(!ResultFile.empty() && !writeResults(ResultFile, names, visitor, result))
+                errs() << "warning: could not write results " << ResultFile << "\n";
+            visitor.callGraph.write(M);
+        }
+        if(!CacheFile.empty()){
+            StatsPhase phase(AnalysisStats::CacheIO);
+            std::string report;
+            raw_string_ostream os(report);
+            visitor.printResult(os);
+            if(!cache.save(CacheFile, os.str()))
+                errs() << "warning: could not write cache " << CacheFile << "\n";
+        }
         
+        // nothing outlives the pass, give the module-wide tables back
+        objIndex.clear();
+        ptsTable.clear();
         return false;
     }
 };
 
+class SteensgaardAnalysis : public ModulePass {
+public:
+
+    static char ID;
+    raw_ostream &out;     /// where the result goes
+    SteensgaardAnalysis() : ModulePass(ID), out(errs()) {}
+    explicit SteensgaardAnalysis(raw_ostream &o) : ModulePass(ID), out(o) {}
 
+    bool runOnModule(Module &M) override {
+        objIndex.clear();
+        objIndex.numberModule(M);
+
+        Point2AnalysisVisitor visitor;
+        SteensgaardSolver solver;
+        solver.solve(M);
+
+        for(Function &fn : M){
+            for(inst_iterator ii = inst_begin(fn), ie = inst_end(fn); ii != ie; ++ii){
+                CallInst* callinst = dyn_cast<CallInst>(&*ii);
+                if(!callinst || isa<DbgInfoIntrinsic>(callinst)) continue;
+
+                LineCallees* names = visitor.getCallOutput(callinst);
+                if(!names) continue;
+                if(Function* alloc = getAllocator(callinst)){
+                    names->insert(alloc);
+                    continue;
+                }
+                for(unsigned obj : solver.getCallees(callinst)){
+                    names->insert(obj);
+                    if(Function* f = dyn_cast<Function>(objIndex.getObject(obj)))
+                        visitor.callGraph.addEdge(callinst, f);
+                }
+            }
+        }
+        visitor.printResult(out);
+        visitor.callGraph.write(M);
+
+        objIndex.clear();
+        ptsTable.clear();
+        return false;
+    }
+};
 
+#endif /* !_POINT2ANALYSIS_H_ */
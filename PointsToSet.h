@@ -0,0 +1,360 @@
+/************************************************************************
+ *
+ * @file PointsToSet.h
+ *
+ * Dense object numbering and bit-vector points-to sets
+ *
+ ***********************************************************************/
+
+#ifndef _POINTSTOSET_H_
+#define _POINTSTOSET_H_
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Hashing.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/SparseBitVector.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Support/CommandLine.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+
+#include "Allocators.h"
+#include "Stats.h"
+#include <vector>
+
+using namespace llvm;
+
+/// A points-to set is a bit vector over object ids, so union, equality
+/// and copy work a word at a time instead of walking tree nodes.
+typedef SparseBitVector<> PtsSet;
+
+static cl::opt<unsigned> FieldLimit("field-limit",
+    cl::desc("Fields an object may have before further offsets into it fall on the object itself (0: field-insensitive)"),
+    cl::init(32));
+
+///
+/// Numbers every abstract object of a module exactly once. Ids are dense,
+/// starting at 0, and stay valid until the index is reset.
+///
+/// Besides the values of the module there are derived nodes, which have
+/// no value of their own:
+///  - the field of an object at a byte offset. Offset 0 is the object
+///    itself, so a struct and its first field share a node, and a field
+///    of a field is a field of the outer object;
+///  - the target of a pointer value nothing is known about, the memory
+///    it points to for want of a better object.
+/// getObject() of a derived node is the value it derives from. Once an
+/// object has FieldLimit fields, further offsets fall on the object, so
+/// pointer arithmetic cannot grow the index without bound. Such a node,
+/// like one that array elements fall on, is collapsed: it stands for
+/// several locations, and a store to one of them keeps the others.
+///
+/// An allocation site is its own heap object, numbered like the allocas
+/// and globals are. Paths name the same nodes across indexes, so work
+/// done in an index of its own can be carried over.
+///
+class ObjectIndex {
+    DenseMap<Value*, unsigned> ids;
+    std::vector<Value*> objs;
+    BitVector heap;           /// ids of the allocation sites
+    BitVector collapsed;      /// ids of the nodes of several locations
+
+    struct Derived {
+        unsigned parent;
+        uint64_t offset;      /// Target for the target node
+    };
+    DenseMap<unsigned, Derived> derived;                       /// derived node -> what it derives from
+    DenseMap<std::pair<unsigned, uint64_t>, unsigned> derivedIDs;
+    DenseMap<unsigned, SmallVector<unsigned, 2> > children;    /// node -> nodes derived from it
+
+    unsigned getDerivedID(unsigned parent, uint64_t offset){
+        auto it = derivedIDs.find({parent, offset});
+        if(it != derivedIDs.end()) return it->second;
+
+        unsigned id = objs.size();
+        objs.push_back(objs[parent]);
+        derived.insert({id, {parent, offset}});
+        derivedIDs.insert({{parent, offset}, id});
+        children[parent].push_back(id);
+        return id;
+    }
+
+public:
+    static const uint64_t Target = ~0ull;
+
+    /// A node by the value it derives from and the offsets that lead
+    /// from there to it, Target for a target. Unlike its id, the path of
+    /// a node means the same in every index of the module.
+    struct Path {
+        Value* value;
+        SmallVector<uint64_t, 2> offsets;
+    };
+
+    /// Id of @v, assigning the next free one on first use
+    unsigned getID(Value* v){
+        auto it = ids.find(v);
+        if(it != ids.end()) return it->second;
+
+        unsigned id = objs.size();
+        ids.insert({v, id});
+        objs.push_back(v);
+        if(getAllocator(v)){
+            if(heap.size() <= id) heap.resize(id + 1);
+            heap.set(id);
+        }
+        return id;
+    }
+
+    /// Id of the node at @path, assigning ids on first use
+    unsigned getID(const Path &path){
+        unsigned id = getID(path.value);
+        for(uint64_t offset : path.offsets){
+            id = offset == Target ? getTargetID(id) : getFieldID(id, offset);
+        }
+        return id;
+    }
+
+    Path getPath(unsigned id) const {
+        Path path;
+        unsigned parent;
+        uint64_t offset;
+        while(getDerived(id, parent, offset)){
+            path.offsets.push_back(offset);
+            id = parent;
+        }
+        path.value = objs[id];
+        std::reverse(path.offsets.begin(), path.offsets.end());
+        return path;
+    }
+
+    Value* getObject(unsigned id) const {
+        return objs[id];
+    }
+
+    unsigned size() const {
+        return objs.size();
+    }
+
+    /// Whether @id is the heap object of an allocation site
+    bool isHeap(unsigned id) const {
+        return id < heap.size() && heap.test(id);
+    }
+
+    bool isHeap(Value* v) const {
+        auto it = ids.find(v);
+        return it != ids.end() && isHeap(it->second);
+    }
+
+    /// Whether @id stands for several locations, fields or elements
+    bool isCollapsed(unsigned id) const {
+        return id < collapsed.size() && collapsed.test(id);
+    }
+
+    void setCollapsed(unsigned id){
+        if(collapsed.size() <= id) collapsed.resize(id + 1);
+        collapsed.set(id);
+    }
+
+    /// Node of the field at @offset bytes into the object @id
+    unsigned getFieldID(unsigned id, uint64_t offset){
+        auto field = derived.find(id);
+        if(field != derived.end() && field->second.offset != Target){
+            id = field->second.parent;
+            offset += field->second.offset;
+        }
+        if(offset == 0 || isa<Function>(objs[id])) return id;
+
+        auto known = derivedIDs.find({id, offset});
+        if(known != derivedIDs.end()) return known->second;
+        // collapsed: the fields so far keep their nodes
+        auto fields = children.find(id);
+        unsigned numFields = fields == children.end() ? 0 : fields->second.size();
+        if(numFields >= FieldLimit){
+            setCollapsed(id);
+            return id;
+        }
+        return getDerivedID(id, offset);
+    }
+
+    /// Node of the memory the pointer @id points to when nothing else is
+    /// known about it
+    unsigned getTargetID(unsigned id){
+        return getDerivedID(id, Target);
+    }
+
+    /// The node @id derives from and the offset, or false if @id is a value
+    bool getDerived(unsigned id, unsigned &parent, uint64_t &offset) const {
+        auto it = derived.find(id);
+        if(it == derived.end()) return false;
+        parent = it->second.parent;
+        offset = it->second.offset;
+        return true;
+    }
+
+    /// Nodes derived from @id: its fields and its target
+    ArrayRef<unsigned> getChildren(unsigned id) const {
+        auto it = children.find(id);
+        return it == children.end() ? ArrayRef<unsigned>() : ArrayRef<unsigned>(it->second);
+    }
+
+    /// Name of node @id, given that of the value it derives from: a
+    /// target is "*name", a field "name+offset"
+    std::string getName(unsigned id, StringRef valueName) const {
+        unsigned parent;
+        uint64_t offset;
+        if(!getDerived(id, parent, offset)) return valueName.str();
+        if(offset == Target) return "*" + getName(parent, valueName);
+        return getName(parent, valueName) + "+" + std::to_string(offset);
+    }
+
+    /// Inverse of getName, with @lookup naming values. Returns false if
+    /// @name names no node.
+    bool parseName(StringRef name, function_ref<Value*(StringRef)> lookup, unsigned &id){
+        uint64_t offset;
+        size_t plus = name.rfind('+');
+        if(plus != StringRef::npos && !name.substr(plus + 1).getAsInteger(10, offset)){
+            if(!parseName(name.substr(0, plus), lookup, id)) return false;
+            id = getFieldID(id, offset);
+            return true;
+        }
+        if(name.startswith("*") && parseName(name.drop_front(), lookup, id)){
+            id = getTargetID(id);
+            return true;
+        }
+        Value* v = lookup(name);
+        if(!v) return false;
+        id = getID(v);
+        return true;
+    }
+
+    /// Assign ids up front, so that they follow module order and the
+    /// hot path only has to look them up
+    void numberModule(Module &M){
+        for(GlobalVariable &gv : M.globals()){
+            getID(&gv);
+        }
+        for(Function &fn : M){
+            getID(&fn);
+            for(Argument &arg : fn.args()){
+                if(arg.getType()->isPointerTy()) getID(&arg);
+            }
+            for(inst_iterator ii = inst_begin(fn), ie = inst_end(fn); ii != ie; ++ii){
+                if(ii->getType()->isPointerTy()) getID(&*ii);
+            }
+        }
+    }
+
+    /// Forget every id and give the memory back
+    void clear(){
+        ids.shrink_and_clear();
+        std::vector<Value*>().swap(objs);
+        heap.clear();
+        collapsed.clear();
+        derived.shrink_and_clear();
+        derivedIDs.shrink_and_clear();
+        children.shrink_and_clear();
+    }
+};
+
+/// One per thread, so that modules can be analyzed side by side
+thread_local ObjectIndex objIndex;
+
+/// An interned, immutable points-to set. Equal sets are the same
+/// pointer, and nullptr is the empty set.
+typedef const PtsSet* PtsRef;
+
+///
+/// Unique table of points-to sets. Every set is stored once, so states
+/// of different blocks share the sets they have in common, and unions
+/// of the same two sets are only computed once.
+///
+class PtsSetTable {
+    std::deque<PtsSet> storage;
+    DenseMap<unsigned, std::vector<PtsRef> > buckets;     /// hash -> sets
+    DenseMap<std::pair<PtsRef, PtsRef>, PtsRef> unions;
+    std::vector<PtsRef> singletons;                      /// object id -> {id}
+
+    /// Bucket key of @s. ~0U and ~0U - 1 are the empty and tombstone
+    /// keys of the DenseMap, so they share the bucket of ~0U - 2.
+    static unsigned hash(const PtsSet &s){
+        hash_code h = hash_value(s.count());
+        for(unsigned id : s) h = hash_combine(h, id);
+        return std::min<unsigned>(h, ~0U - 2);
+    }
+
+public:
+    PtsRef intern(const PtsSet &s){
+        if(s.empty()) return nullptr;
+
+        std::vector<PtsRef> &bucket = buckets[hash(s)];
+        for(PtsRef known : bucket){
+            if(*known == s) return known;
+        }
+        storage.push_back(s);
+        bucket.push_back(&storage.back());
+        stats.setsInterned++;
+        if(statsEnabled) stats.maxPtsSize = std::max<uint64_t>(stats.maxPtsSize, s.count());
+        return &storage.back();
+    }
+
+    /// The set of @ids
+    PtsRef intern(ArrayRef<unsigned> ids){
+        if(ids.empty()) return nullptr;
+        if(ids.size() == 1) return insert(nullptr, ids[0]);
+        PtsSet s;
+        for(unsigned id : ids) s.set(id);
+        return intern(s);
+    }
+
+    PtsRef unite(PtsRef a, PtsRef b){
+        if(a == b || !b) return a;
+        if(!a) return b;
+        if(b < a) std::swap(a, b);
+
+        auto cached = unions.find({a, b});
+        if(cached != unions.end()){
+            stats.unionHits++;
+            return cached->second;
+        }
+
+        PtsSet s = *a;
+        s |= *b;
+        PtsRef result = intern(s);
+        stats.unions++;
+        if(statsEnabled) stats.unionElements += result->count();
+        unions.insert({{a, b}, result});
+        return result;
+    }
+
+    /// a ∪ {id}
+    PtsRef insert(PtsRef a, unsigned id){
+        if(a && a->test(id)) return a;
+        if(id >= singletons.size()) singletons.resize(id + 1);
+        if(!singletons[id]){
+            PtsSet s;
+            s.set(id);
+            singletons[id] = intern(s);
+        }
+        return unite(a, singletons[id]);
+    }
+
+    unsigned size() const {
+        return storage.size();
+    }
+
+    /// Drop every set and give the memory back, invalidating all PtsRefs
+    void clear(){
+        unions.shrink_and_clear();
+        buckets.shrink_and_clear();
+        std::vector<PtsRef>().swap(singletons);
+        std::deque<PtsSet>().swap(storage);
+    }
+};
+
+thread_local PtsSetTable ptsTable;
+
+#endif /* !_POINTSTOSET_H_ */
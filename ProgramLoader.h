@@ -0,0 +1,209 @@
+/************************************************************************
+ *
+ * @file ProgramLoader.h
+ *
+ * Loading several bitcode files as one program, reachable bodies only
+ *
+ ***********************************************************************/
+
+#ifndef _PROGRAMLOADER_H_
+#define _PROGRAMLOADER_H_
+
+#include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/IRMover.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/SourceMgr.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+/// Append @path to @files, or every .bc file in it, in name order, if it
+/// is a directory
+void collectInputs(StringRef path, std::vector<std::string> &files){
+    if(!sys::fs::is_directory(path)){
+        files.push_back(path.str());
+        return ;
+    }
+    std::vector<std::string> found;
+    std::error_code ec;
+    for(sys::fs::directory_iterator di(path, ec), de; di != de && !ec; di.increment(ec)){
+        if(StringRef(di->path()).endswith(".bc")) found.push_back(di->path());
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+///
+/// Builds one module out of many bitcode files. Every file is opened
+/// lazily, so only its globals and symbol table are read; function bodies
+/// are deserialized only once they are reachable from the entry, by a
+/// call or by taking the address. The reached definitions are then moved
+/// into a single module, with the entry last, since the analyses take the
+/// last function with a body as the root.
+///
+/// An external symbol defined in several files resolves to the file of
+/// the entry, then to the first file that defines it. Functions never
+/// reached stay behind, so the flow-insensitive engines do not see them
+/// either.
+///
+class ProgramLoader {
+    LLVMContext &context;
+    std::vector<std::unique_ptr<Module> > modules;
+    std::vector<std::string> paths;
+    StringMap<GlobalValue*> definitions;     /// external name -> chosen definition
+    SetVector<GlobalValue*> reached;
+
+    /// The definition @gv refers to, which may live in another module
+    GlobalValue* resolve(GlobalValue* gv){
+        if(!gv->isDeclaration() || gv->hasLocalLinkage()) return gv;
+        auto def = definitions.find(gv->getName());
+        return def == definitions.end() ? gv : def->second;
+    }
+
+    void reach(GlobalValue* gv, std::vector<GlobalValue*> &pending){
+        gv = resolve(gv);
+        if(reached.insert(gv)) pending.push_back(gv);
+    }
+
+    /// Queue every global that @c mentions
+    void scanConstant(Constant* c, std::vector<GlobalValue*> &pending){
+        if(GlobalValue* gv = dyn_cast<GlobalValue>(c)){
+            reach(gv, pending);
+            return ;
+        }
+        for(Value* op : c->operands()){
+            if(Constant* sub = dyn_cast<Constant>(op)) scanConstant(sub, pending);
+        }
+    }
+
+    bool visit(GlobalValue* gv, std::vector<GlobalValue*> &pending, SMDiagnostic &err){
+        if(GlobalVariable* var = dyn_cast<GlobalVariable>(gv)){
+            if(var->hasInitializer()) scanConstant(var->getInitializer(), pending);
+            return true;
+        }
+        if(GlobalAlias* alias = dyn_cast<GlobalAlias>(gv)){
+            scanConstant(alias->getAliasee(), pending);
+            return true;
+        }
+        Function* fn = dyn_cast<Function>(gv);
+        if(!fn || fn->isDeclaration()) return true;
+        if(Error e = fn->materialize()){
+            err = SMDiagnostic(fn->getParent()->getModuleIdentifier(), SourceMgr::DK_Error,
+                               toString(std::move(e)));
+            return false;
+        }
+        for(inst_iterator ii = inst_begin(*fn), ie = inst_end(*fn); ii != ie; ++ii){
+            for(Value* op : ii->operands()){
+                if(Constant* c = dyn_cast<Constant>(op)) scanConstant(c, pending);
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit ProgramLoader(LLVMContext &c) : context(c) {}
+
+    /// Add @path, or every .bc file in it if it is a directory, in name
+    /// order
+    bool addInput(StringRef path, SMDiagnostic &err){
+        std::vector<std::string> files;
+        collectInputs(path, files);
+
+        for(const std::string &file : files){
+            std::unique_ptr<Module> M = getLazyIRFileModule(file, err, context);
+            if(!M) return false;
+            modules.push_back(std::move(M));
+            paths.push_back(file);
+        }
+        return true;
+    }
+
+    unsigned getNumInputs() const {
+        return modules.size();
+    }
+
+    /// Link what @entry reaches into one module. An empty @entry means the
+    /// last function with a body in the last input.
+    std::unique_ptr<Module> link(StringRef entry, SMDiagnostic &err){
+        if(modules.empty()){
+            err = SMDiagnostic("", SourceMgr::DK_Error, "no input files");
+            return nullptr;
+        }
+
+        Function* root = nullptr;
+        if(entry.empty()){
+            for(auto f = modules.back()->rbegin(), e = modules.back()->rend(); f != e && !root; ++f){
+                if(!f->isDeclaration() && !f->isIntrinsic()) root = &*f;
+            }
+        }
+        for(unsigned i=0;i<modules.size() && !root;i++){
+            Function* f = modules[i]->getFunction(entry);
+            if(f && !f->isDeclaration()) root = f;
+        }
+        if(!root){
+            err = SMDiagnostic("", SourceMgr::DK_Error,
+                               entry.empty() ? "no function with a body" : ("entry " + entry + " is not defined").str());
+            return nullptr;
+        }
+
+        // the entry's own module wins, then the inputs in order
+        std::vector<unsigned> order;
+        for(unsigned i=0;i<modules.size();i++){
+            if(modules[i].get() == root->getParent()) order.insert(order.begin(), i);
+            else order.push_back(i);
+        }
+        for(unsigned i : order){
+            for(GlobalValue &gv : modules[i]->global_values()){
+                if(!gv.isDeclaration() && !gv.hasLocalLinkage() && gv.hasName())
+                    definitions.insert({gv.getName(), &gv});
+            }
+        }
+
+        std::vector<GlobalValue*> pending;
+        reach(root, pending);
+        while(!pending.empty()){
+            GlobalValue* gv = pending.back();
+            pending.pop_back();
+            if(!visit(gv, pending, err)) return nullptr;
+        }
+
+        std::string rootName = root->getName().str();
+        auto linked = std::make_unique<Module>("program", context);
+        linked->setDataLayout(root->getParent()->getDataLayout());
+        linked->setTargetTriple(root->getParent()->getTargetTriple());
+        IRMover mover(*linked);
+        for(unsigned i : order){
+            std::vector<GlobalValue*> values;
+            for(GlobalValue &gv : modules[i]->global_values()){
+                if(reached.count(&gv) && !gv.isDeclaration()) values.push_back(&gv);
+            }
+            Error e = mover.move(std::move(modules[i]), values,
+                                 [](GlobalValue &, IRMover::ValueAdder){}, /*IsPerformingImport=*/false);
+            if(e){
+                err = SMDiagnostic(paths[i], SourceMgr::DK_Error, toString(std::move(e)));
+                return nullptr;
+            }
+        }
+        modules.clear();
+        definitions.clear();
+        reached.clear();
+
+        // the entry was moved first, so a clashing local got renamed instead
+        if(Function* moved = linked->getFunction(rootName)){
+            moved->removeFromParent();
+            linked->getFunctionList().push_back(moved);
+        }
+        return linked;
+    }
+};
+
+#endif /* !_PROGRAMLOADER_H_ */
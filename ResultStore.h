@@ -0,0 +1,363 @@
+/************************************************************************
+ *
+ * @file ResultStore.h
+ *
+ * Compact binary store of analysis results, and a reader that maps it
+ *
+ ***********************************************************************/
+
+#ifndef _RESULTSTORE_H_
+#define _RESULTSTORE_H_
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+///
+/// Layout of a result file. Everything is a little-endian 32-bit word and
+/// every offset counts words from the start of the file, so a reader can
+/// map the file and index into it without parsing anything:
+///
+///   header    magic, version, then (offset, count) of every section
+///   strings   (byte offset, length) into the blob, then the blob itself
+///   objects   name string of each object id, then the ids sorted by name
+///   sets      (offset, count) into the set data; set 0 is the empty set
+///   blocks    (function, first inst, insts, in offset, in count, out
+///             offset, out count), sorted by function name and first
+///             inst; a state is a run of (object, set) pairs sorted by
+///             object
+///   lines     (line, offset, count) sorted by line; the data are the
+///             strings naming the callees reported at that line
+///
+namespace resultstore {
+    const char Magic[8] = {'P', 'T', 'S', 'R', 'S', 'L', 'T', '1'};
+    const unsigned Version = 1;
+
+    enum Section { Strings, Blob, Objects, ByName, Sets, SetData, Blocks, States, Lines, LineData, NumSections };
+    const unsigned HeaderWords = 3 + 2 * NumSections;
+    const unsigned BlockWords = 7;
+}
+
+///
+/// Collects results in terms of dense ids and writes them out in one go.
+/// Objects must be added in id order; sets and strings are interned.
+///
+class ResultStoreWriter {
+    struct Block {
+        unsigned fn, first, count;
+        std::vector<std::pair<unsigned, unsigned> > in, out;
+    };
+
+    std::vector<std::string> strings;
+    StringMap<unsigned> stringIds;
+    std::vector<unsigned> objects;
+    std::vector<std::vector<unsigned> > sets{{}};
+    std::map<std::vector<unsigned>, unsigned> setIds{{{}, 0}};
+    std::vector<Block> blocks;
+    std::map<unsigned, std::vector<unsigned> > lines;
+
+    template<class Words>
+    static void section(std::vector<uint32_t> &file, unsigned which, const Words &words, unsigned count){
+        file[3 + 2 * which] = file.size();
+        file[4 + 2 * which] = count;
+        file.insert(file.end(), words.begin(), words.end());
+    }
+
+public:
+    unsigned addString(StringRef s){
+        auto known = stringIds.find(s);
+        if(known != stringIds.end()) return known->second;
+        stringIds[s] = strings.size();
+        strings.push_back(s.str());
+        return strings.size() - 1;
+    }
+
+    /// Add the next object id, named @name
+    unsigned addObject(StringRef name){
+        objects.push_back(addString(name));
+        return objects.size() - 1;
+    }
+
+    /// Id of the set of object ids @ids, which must be sorted
+    unsigned addSet(const std::vector<unsigned> &ids){
+        auto known = setIds.find(ids);
+        if(known != setIds.end()) return known->second;
+        setIds.insert({ids, sets.size()});
+        sets.push_back(ids);
+        return sets.size() - 1;
+    }
+
+    /// Add a block of @fn covering @count instructions from index @first,
+    /// with its in and out states as (object, set) pairs
+    void addBlock(StringRef fn, unsigned first, unsigned count,
+                  std::vector<std::pair<unsigned, unsigned> > in,
+                  std::vector<std::pair<unsigned, unsigned> > out){
+        std::sort(in.begin(), in.end());
+        std::sort(out.begin(), out.end());
+        blocks.push_back({addString(fn), first, count, std::move(in), std::move(out)});
+    }
+
+    /// Report @callees for source line @line, which may be none
+    void addLine(unsigned line, ArrayRef<StringRef> callees){
+        std::vector<unsigned> &ids = lines[line];
+        for(StringRef callee : callees) ids.push_back(addString(callee));
+    }
+
+    bool write(StringRef path){
+        using namespace resultstore;
+        std::vector<uint32_t> file(HeaderWords);
+        file[0] = support::endian::read32le(Magic);
+        file[1] = support::endian::read32le(Magic + 4);
+        file[2] = Version;
+
+        std::vector<uint32_t> words;
+        std::string blob;
+        for(const std::string &s : strings){
+            words.push_back(blob.size());
+            words.push_back(s.size());
+            blob += s;
+        }
+        section(file, Strings, words, strings.size());
+        blob.resize(alignTo(blob.size(), 4));
+        words.assign(blob.size() / 4, 0);
+        for(unsigned i=0;i<words.size();i++) words[i] = support::endian::read32le(blob.data() + 4 * i);
+        section(file, Blob, words, blob.size());
+
+        section(file, Objects, objects, objects.size());
+        std::vector<uint32_t> byName(objects.size());
+        for(unsigned i=0;i<byName.size();i++) byName[i] = i;
+        std::stable_sort(byName.begin(), byName.end(), [&](unsigned a, unsigned b){
+            return strings[objects[a]] < strings[objects[b]];
+        });
+        section(file, ByName, byName, byName.size());
+
+        std::vector<uint32_t> data;
+        words.clear();
+        for(const std::vector<unsigned> &set : sets){
+            words.push_back(data.size());
+            words.push_back(set.size());
+            data.insert(data.end(), set.begin(), set.end());
+        }
+        section(file, Sets, words, sets.size());
+        unsigned base = file.size();
+        section(file, SetData, data, data.size());
+        for(unsigned i=0;i<sets.size();i++) file[file[3 + 2 * Sets] + 2 * i] += base;
+
+        std::stable_sort(blocks.begin(), blocks.end(), [&](const Block &a, const Block &b){
+            if(a.fn != b.fn) return strings[a.fn] < strings[b.fn];
+            return a.first < b.first;
+        });
+        data.clear();
+        words.clear();
+        for(const Block &block : blocks){
+            words.insert(words.end(), {block.fn, block.first, block.count});
+            for(auto *state : {&block.in, &block.out}){
+                words.push_back(data.size());
+                words.push_back(state->size());
+                for(auto &slot : *state) data.insert(data.end(), {slot.first, slot.second});
+            }
+        }
+        section(file, Blocks, words, blocks.size());
+        base = file.size();
+        section(file, States, data, data.size() / 2);
+        for(unsigned i=0;i<blocks.size();i++){
+            file[file[3 + 2 * Blocks] + BlockWords * i + 3] += base;
+            file[file[3 + 2 * Blocks] + BlockWords * i + 5] += base;
+        }
+
+        data.clear();
+        words.clear();
+        for(auto &line : lines){
+            words.insert(words.end(), {line.first, (unsigned)data.size(), (unsigned)line.second.size()});
+            data.insert(data.end(), line.second.begin(), line.second.end());
+        }
+        section(file, Lines, words, lines.size());
+        base = file.size();
+        section(file, LineData, data, data.size());
+        for(unsigned i=0;i<lines.size();i++) file[file[3 + 2 * Lines] + 3 * i + 1] += base;
+
+        std::error_code ec;
+        raw_fd_ostream out(path, ec, sys::fs::OF_None);
+        if(ec) return false;
+        support::endian::write<uint32_t>(out, file, support::little);
+        return !out.has_error();
+    }
+};
+
+///
+/// Random access to a result file. The file is mapped, not read, and
+/// every query only touches the words it needs; lookups by name or line
+/// are binary searches. Offsets are checked against the file size, so a
+/// truncated or corrupt file gives empty answers instead of crashing.
+///
+class ResultStoreReader {
+    typedef support::ulittle32_t Word;
+
+    std::unique_ptr<MemoryBuffer> file;
+    ArrayRef<Word> words;
+
+    unsigned getOffset(unsigned section) const {
+        return words[3 + 2 * section];
+    }
+
+    unsigned getCount(unsigned section) const {
+        return words[4 + 2 * section];
+    }
+
+    /// @count words from @offset, or none if they run past the file
+    ArrayRef<Word> span(uint64_t offset, uint64_t count) const {
+        if(offset + count > words.size()) return ArrayRef<Word>();
+        return words.slice(offset, count);
+    }
+
+    /// Entry @i of the table @section of @width words per entry
+    ArrayRef<Word> entry(unsigned section, unsigned i, unsigned width) const {
+        if(i >= getCount(section)) return ArrayRef<Word>();
+        return span(getOffset(section) + (uint64_t)width * i, width);
+    }
+
+public:
+    /// Map @path. Returns false with @err set if it is not a result file.
+    bool open(StringRef path, std::string &err){
+        using namespace resultstore;
+        ErrorOr<std::unique_ptr<MemoryBuffer> > buf =
+            MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+        if(!buf){
+            err = buf.getError().message();
+            return false;
+        }
+        StringRef bytes = (*buf)->getBuffer();
+        if(bytes.size() % 4 || bytes.size() < 4 * HeaderWords || !bytes.startswith(StringRef(Magic, 8))){
+            err = "not a result file";
+            return false;
+        }
+        file = std::move(*buf);
+        words = makeArrayRef(reinterpret_cast<const Word*>(file->getBufferStart()), bytes.size() / 4);
+        if(words[2] != Version){
+            err = "unsupported result file version";
+            file.reset();
+            words = ArrayRef<Word>();
+            return false;
+        }
+        return true;
+    }
+
+    unsigned getNumObjects() const {
+        return getCount(resultstore::Objects);
+    }
+
+    unsigned getNumBlocks() const {
+        return getCount(resultstore::Blocks);
+    }
+
+    unsigned getNumLines() const {
+        return getCount(resultstore::Lines);
+    }
+
+    StringRef getString(unsigned id) const {
+        ArrayRef<Word> s = entry(resultstore::Strings, id, 2);
+        if(s.empty() || (uint64_t)s[0] + s[1] > getCount(resultstore::Blob)) return StringRef();
+        const char* blob = reinterpret_cast<const char*>(words.data() + getOffset(resultstore::Blob));
+        return StringRef(blob + s[0], s[1]);
+    }
+
+    StringRef getObjectName(unsigned obj) const {
+        ArrayRef<Word> name = entry(resultstore::Objects, obj, 1);
+        return name.empty() ? StringRef() : getString(name[0]);
+    }
+
+    /// Id of the object named @name, or -1
+    int findObject(StringRef name) const {
+        ArrayRef<Word> byName = span(getOffset(resultstore::ByName), getCount(resultstore::ByName));
+        auto it = std::lower_bound(byName.begin(), byName.end(), name, [&](Word obj, StringRef n){
+            return getObjectName(obj) < n;
+        });
+        if(it == byName.end() || getObjectName(*it) != name) return -1;
+        return *it;
+    }
+
+    /// Object ids in set @set
+    ArrayRef<Word> getSet(unsigned set) const {
+        ArrayRef<Word> s = entry(resultstore::Sets, set, 2);
+        return s.empty() ? ArrayRef<Word>() : span(s[0], s[1]);
+    }
+
+    StringRef getBlockFunction(unsigned block) const {
+        ArrayRef<Word> b = entry(resultstore::Blocks, block, resultstore::BlockWords);
+        return b.empty() ? StringRef() : getString(b[0]);
+    }
+
+    /// Index range [first, first + count) of the instructions of @block
+    std::pair<unsigned, unsigned> getBlockInsts(unsigned block) const {
+        ArrayRef<Word> b = entry(resultstore::Blocks, block, resultstore::BlockWords);
+        return b.empty() ? std::make_pair(0u, 0u) : std::make_pair((unsigned)b[1], (unsigned)b[2]);
+    }
+
+    /// Block holding instruction number @inst of @fn, or -1
+    int findBlock(StringRef fn, unsigned inst) const {
+        // last block of fn starting at or before inst
+        unsigned lo = 0, hi = getNumBlocks();
+        while(lo < hi){
+            unsigned mid = lo + (hi - lo) / 2;
+            StringRef f = getBlockFunction(mid);
+            if(f < fn || (f == fn && getBlockInsts(mid).first <= inst)) lo = mid + 1;
+            else hi = mid;
+        }
+        // empty blocks sort before the block that starts where they are
+        for(int b = (int)lo - 1; b >= 0 && getBlockFunction(b) == fn; b--){
+            std::pair<unsigned, unsigned> insts = getBlockInsts(b);
+            if(!insts.second) continue;
+            return inst < insts.first + insts.second ? b : -1;
+        }
+        return -1;
+    }
+
+    /// Objects @obj may point to on entry to (or exit from, if @out) @block
+    ArrayRef<Word> getPts(unsigned block, unsigned obj, bool out = false) const {
+        ArrayRef<Word> b = entry(resultstore::Blocks, block, resultstore::BlockWords);
+        if(b.empty()) return ArrayRef<Word>();
+        ArrayRef<Word> state = span(out ? b[5] : b[3], 2 * (uint64_t)(out ? b[6] : b[4]));
+
+        unsigned lo = 0, hi = state.size() / 2;
+        while(lo < hi){
+            unsigned mid = lo + (hi - lo) / 2;
+            if(state[2 * mid] < obj) lo = mid + 1;
+            else hi = mid;
+        }
+        if(lo == state.size() / 2 || state[2 * lo] != obj) return ArrayRef<Word>();
+        return getSet(state[2 * lo + 1]);
+    }
+
+    /// Line number of the @i-th reported line, in ascending order
+    unsigned getLine(unsigned i) const {
+        ArrayRef<Word> l = entry(resultstore::Lines, i, 3);
+        return l.empty() ? 0 : (unsigned)l[0];
+    }
+
+    /// Callees reported for the calls on source line @line
+    std::vector<StringRef> getCallees(unsigned line) const {
+        unsigned lo = 0, hi = getNumLines();
+        while(lo < hi){
+            unsigned mid = lo + (hi - lo) / 2;
+            if(getLine(mid) < line) lo = mid + 1;
+            else hi = mid;
+        }
+        std::vector<StringRef> callees;
+        ArrayRef<Word> l = entry(resultstore::Lines, lo, 3);
+        if(l.empty() || l[0] != line) return callees;
+        for(Word s : span(l[1], l[2])) callees.push_back(getString(s));
+        return callees;
+    }
+};
+
+#endif /* !_RESULTSTORE_H_ */
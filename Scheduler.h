@@ -0,0 +1,162 @@
+/************************************************************************
+ *
+ * @file Scheduler.h
+ *
+ * Work-stealing thread pool for independent jobs, such as the modules of -batch
+ *
+ ***********************************************************************/
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///
+/// Runs batches of independent jobs on a fixed number of threads. Every
+/// thread owns a deque of jobs: it takes work from the back of its own
+/// deque and, once that runs dry, steals from the front of the others',
+/// so a few large jobs do not leave the remaining threads idle. The
+/// threads are started by the first batch that needs them and wait for
+/// the next one until the pool is destroyed, so a batch costs a wake-up
+/// rather than a thread start per worker.
+///
+class WorkStealingPool {
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> jobs;
+    };
+
+    unsigned nthreads;
+    std::vector<Queue> queues;           /// one per thread, the caller's first
+    std::vector<std::thread> workers;
+
+    std::mutex lock;                     /// guards everything below
+    std::condition_variable wake;        /// a batch started, or the pool is stopping
+    std::condition_variable done;        /// the last helper finished its batch
+    const std::function<void(size_t)>* batch = nullptr;
+    unsigned batchThreads = 0;           /// threads that take part in the batch
+    unsigned busy = 0;                   /// helpers still working on it
+    uint64_t generation = 0;             /// number of batches started
+    bool stopping = false;
+
+    /// The pool whose job this thread is running, if any
+    static const WorkStealingPool*& getRunning(){
+        static thread_local const WorkStealingPool* running = nullptr;
+        return running;
+    }
+
+    static bool take(Queue &q, bool own, size_t &job){
+        std::lock_guard<std::mutex> guard(q.lock);
+        if(q.jobs.empty()) return false;
+        if(own){
+            job = q.jobs.back();
+            q.jobs.pop_back();
+        }
+        else{
+            job = q.jobs.front();
+            q.jobs.pop_front();
+        }
+        return true;
+    }
+
+    /// Run the jobs of the current batch as its thread @self until no
+    /// deque has any left
+    void work(unsigned self, unsigned threads, const std::function<void(size_t)> &job){
+        size_t i;
+        while(true){
+            bool found = take(queues[self], true, i);
+            for(unsigned k=1;k<threads && !found;k++){
+                found = take(queues[(self + k) % threads], false, i);
+            }
+            // no job ever gets queued again, so every deque is empty
+            if(!found) return ;
+            job(i);
+        }
+    }
+
+    /// Body of helper thread @self: run every batch it takes part in
+    void serve(unsigned self){
+        getRunning() = this;
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> guard(lock);
+        while(true){
+            wake.wait(guard, [&]{ return stopping || generation != seen; });
+            if(stopping) return ;
+            seen = generation;
+            if(self >= batchThreads) continue;
+
+            const std::function<void(size_t)> &job = *batch;
+            unsigned threads = batchThreads;
+            guard.unlock();
+            work(self, threads, job);
+            guard.lock();
+            if(--busy == 0) done.notify_one();
+        }
+    }
+
+public:
+    explicit WorkStealingPool(unsigned threads) : nthreads(std::max(threads, 1u)), queues(nthreads) {}
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool(){
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(std::thread &t : workers){
+            t.join();
+        }
+    }
+
+    unsigned size() const {
+        return nthreads;
+    }
+
+    /// Call @job(i) for every i in [0, n) and return once all calls are
+    /// done. Jobs must not touch each other's state. The calling thread
+    /// runs jobs too, and a job that starts a batch of its own pool runs
+    /// that batch by itself.
+    void forEach(size_t n, const std::function<void(size_t)> &job){
+        unsigned threads = std::min<size_t>(nthreads, n);
+        if(threads <= 1 || getRunning() == this){
+            for(size_t i=0;i<n;i++) job(i);
+            return ;
+        }
+
+        for(size_t i=0;i<n;i++){
+            queues[i % threads].jobs.push_back(i);
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for(unsigned t=workers.size()+1;t<nthreads;t++){
+                workers.emplace_back(&WorkStealingPool::serve, this, t);
+            }
+            batch = &job;
+            batchThreads = threads;
+            busy = threads - 1;
+            generation++;
+        }
+        wake.notify_all();
+
+        const WorkStealingPool* outer = getRunning();
+        getRunning() = this;
+        work(0, threads, job);
+        getRunning() = outer;
+
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&]{ return busy == 0; });
+        batch = nullptr;
+    }
+};
+
+#endif /* !_SCHEDULER_H_ */
@@ -0,0 +1,167 @@
+/************************************************************************
+ *
+ * @file Stats.h
+ *
+ * Per-phase wall times and solver counters, written as JSON
+ *
+ ***********************************************************************/
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+using namespace llvm;
+
+/// Whether -analysis-stats was given. Counters are bumped regardless,
+/// which costs no more than testing this; clocks and set sizes are only
+/// read if it was.
+bool statsEnabled = false;
+
+static cl::opt<std::string> StatsFile("analysis-stats",
+    cl::desc("Write per-phase wall times and solver counters as JSON to this file at exit (- for stdout)"),
+    cl::value_desc("file"), cl::init(""),
+    cl::callback([](const std::string &path){ statsEnabled = !path.empty(); }));
+
+///
+/// Counters of one thread. Phase times are inclusive, and a phase that
+/// is re-entered (a call handled inside a summary solve started by a
+/// call) is only timed at its outermost entry.
+///
+struct AnalysisStats {
+    enum Phase { PreProcess, Solve, Merge, CallHandling, Unification, Inclusion, CacheIO, Output, NumPhases };
+
+    static const char* getPhaseName(unsigned phase){
+        static const char* const names[NumPhases] = {
+            "preProcess", "solve", "merge", "handleCallInst",
+            "steensgaard", "andersen", "cache", "output"
+        };
+        return names[phase];
+    }
+
+    double seconds[NumPhases] = {};
+    uint64_t entries[NumPhases] = {};
+    unsigned depth[NumPhases] = {};
+
+    uint64_t cfgFunctions = 0;
+    uint64_t cfgBlocks = 0;
+    uint64_t worklistPushes = 0;
+    uint64_t worklistPops = 0;
+    uint64_t merges = 0;
+    uint64_t unions = 0;            /// unions computed
+    uint64_t unionHits = 0;         /// unions answered from the memo table
+    uint64_t unionElements = 0;     /// total size of the computed unions
+    uint64_t setsInterned = 0;
+    uint64_t maxPtsSize = 0;        /// largest points-to set interned
+    uint64_t callsHandled = 0;
+    uint64_t splices = 0;           /// callee CFGs wired in by init_new_func
+
+    void add(const AnalysisStats &other){
+        for(unsigned p=0;p<NumPhases;p++){
+            seconds[p] += other.seconds[p];
+            entries[p] += other.entries[p];
+        }
+        cfgFunctions += other.cfgFunctions;
+        cfgBlocks += other.cfgBlocks;
+        worklistPushes += other.worklistPushes;
+        worklistPops += other.worklistPops;
+        merges += other.merges;
+        unions += other.unions;
+        unionHits += other.unionHits;
+        unionElements += other.unionElements;
+        setsInterned += other.setsInterned;
+        maxPtsSize = std::max(maxPtsSize, other.maxPtsSize);
+        callsHandled += other.callsHandled;
+        splices += other.splices;
+    }
+};
+
+thread_local AnalysisStats stats;
+
+AnalysisStats totalStats;     /// flushed counters of every thread
+std::mutex totalStatsLock;
+
+///
+/// Times the enclosing scope as @phase, if -analysis-stats is on
+///
+class StatsPhase {
+    AnalysisStats::Phase phase;
+    bool timing = false;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit StatsPhase(AnalysisStats::Phase p) : phase(p) {
+        if(!statsEnabled || stats.depth[phase]++) return;
+        timing = true;
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~StatsPhase(){
+        if(!statsEnabled) return;
+        stats.depth[phase]--;
+        if(!timing) return;
+        stats.seconds[phase] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.entries[phase]++;
+    }
+};
+
+/// Add the counters of this thread to the totals and reset them
+void flushStats(){
+    std::lock_guard<std::mutex> guard(totalStatsLock);
+    totalStats.add(stats);
+    stats = AnalysisStats();
+}
+
+/// Flush this thread and write the totals to -analysis-stats, if given
+bool writeStats(){
+    if(!statsEnabled) return true;
+    flushStats();
+
+    std::error_code ec;
+    raw_fd_ostream file(StatsFile.getValue(), ec, sys::fs::OF_Text);
+    if(ec){
+        errs() << "warning: could not write stats " << StatsFile << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    const AnalysisStats &s = totalStats;
+    json::OStream out(file, 2);
+    out.object([&]{
+        out.attributeObject("phases", [&]{
+            for(unsigned p=0;p<AnalysisStats::NumPhases;p++){
+                if(!s.entries[p]) continue;
+                out.attributeObject(AnalysisStats::getPhaseName(p), [&]{
+                    out.attribute("seconds", s.seconds[p]);
+                    out.attribute("entries", (int64_t)s.entries[p]);
+                });
+            }
+        });
+        out.attributeObject("counters", [&]{
+            out.attribute("cfg_functions", (int64_t)s.cfgFunctions);
+            out.attribute("cfg_blocks", (int64_t)s.cfgBlocks);
+            out.attribute("worklist_pushes", (int64_t)s.worklistPushes);
+            out.attribute("worklist_pops", (int64_t)s.worklistPops);
+            out.attribute("merges", (int64_t)s.merges);
+            out.attribute("unions", (int64_t)s.unions);
+            out.attribute("union_memo_hits", (int64_t)s.unionHits);
+            out.attribute("union_elements", (int64_t)s.unionElements);
+            out.attribute("mean_union_size", s.unions ? (double)s.unionElements / s.unions : 0.0);
+            out.attribute("sets_interned", (int64_t)s.setsInterned);
+            out.attribute("max_pts_size", (int64_t)s.maxPtsSize);
+            out.attribute("calls_handled", (int64_t)s.callsHandled);
+            out.attribute("cfg_splices", (int64_t)s.splices);
+        });
+    });
+    file << "\n";
+    return !file.has_error();
+}
+
+#endif /* !_STATS_H_ */
@@ -0,0 +1,277 @@
+/************************************************************************
+ *
+ * @file Steensgaard.h
+ *
+ * Unification-based (Steensgaard) points-to analysis
+ *
+ ***********************************************************************/
+
+#ifndef _STEENSGAARD_H_
+#define _STEENSGAARD_H_
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Module.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <vector>
+
+#include "PointsToSet.h"
+using namespace llvm;
+
+///
+/// Almost linear call resolution. Every pointer value lives in an
+/// equivalence class, and every class points to at most one other class;
+/// assignments unify the pointee classes of both sides instead of adding
+/// inclusion edges. Indirect calls are bound to their targets on the fly
+/// until no new target shows up.
+///
+class SteensgaardSolver {
+    std::vector<unsigned> parent;       /// union-find over nodes
+    std::vector<int> pointee;           /// class each class points to, -1 if none yet
+    std::vector<PtsSet> objs;           /// objects whose storage is this class
+
+    DenseMap<Value*, unsigned> valueNode;
+    DenseMap<Function*, unsigned> retNode;
+    std::vector<CallInst*> indirectCalls;
+    DenseSet<std::pair<CallInst*, Function*> > bound;
+    DenseMap<CallInst*, PtsSet> callees;
+    DenseSet<Function*> reachable;
+
+    unsigned newNode(){
+        unsigned n = parent.size();
+        parent.push_back(n);
+        pointee.push_back(-1);
+        objs.emplace_back();
+        return n;
+    }
+
+    unsigned find(unsigned n){
+        while(parent[n] != n){
+            parent[n] = parent[parent[n]];
+            n = parent[n];
+        }
+        return n;
+    }
+
+    static bool isObject(Value* v){
+        if(isa<Function>(v) || isa<GlobalVariable>(v) || isa<AllocaInst>(v)) return true;
+        return getAllocator(v) != nullptr;
+    }
+
+    unsigned getNode(Value* v){
+        // field-insensitive: constant casts and GEPs are their base pointer
+        while(ConstantExpr* ce = dyn_cast<ConstantExpr>(v)){
+            if(!ce->isCast() && ce->getOpcode() != Instruction::GetElementPtr) break;
+            v = ce->getOperand(0);
+        }
+        auto it = valueNode.find(v);
+        if(it != valueNode.end()) return find(it->second);
+
+        unsigned n = newNode();
+        valueNode.insert({v, n});
+        if(isObject(v)){
+            unsigned storage = newNode();
+            objs[storage].set(objIndex.getID(v));
+            pointee[n] = storage;
+        }
+        return n;
+    }
+
+    unsigned getPointee(unsigned n){
+        n = find(n);
+        if(pointee[n] < 0){
+            unsigned p = newNode();
+            pointee[n] = p;
+        }
+        return find(pointee[n]);
+    }
+
+    unsigned getRetNode(Function* f){
+        auto it = retNode.find(f);
+        if(it != retNode.end()) return find(it->second);
+
+        unsigned n = newNode();
+        retNode.insert({f, n});
+        return n;
+    }
+
+    void join(unsigned a, unsigned b){
+        std::vector<std::pair<unsigned, unsigned> > pending{{a, b}};
+        while(!pending.empty()){
+            a = find(pending.back().first);
+            b = find(pending.back().second);
+            pending.pop_back();
+            if(a == b) continue;
+
+            parent[b] = a;
+            objs[a] |= objs[b];
+            objs[b].clear();
+            if(pointee[a] < 0) pointee[a] = pointee[b];
+            else if(pointee[b] >= 0) pending.push_back({(unsigned)pointee[a], (unsigned)pointee[b]});
+        }
+    }
+
+    /// x = y
+    void assign(Value* x, Value* y){
+        unsigned px = getPointee(getNode(x));
+        unsigned py = getPointee(getNode(y));
+        join(px, py);
+    }
+
+    void handleLoadInst(LoadInst* loadinst){
+        if(!loadinst->getType()->isPointerTy()) return ;
+        unsigned px = getPointee(getNode(loadinst));
+        unsigned py = getPointee(getPointee(getNode(loadinst->getPointerOperand())));
+        join(px, py);
+    }
+
+    void handleStoreInst(StoreInst* storeinst){
+        Value* y = storeinst->getValueOperand();
+        if(!y->getType()->isPointerTy()) return ;
+        unsigned px = getPointee(getPointee(getNode(storeinst->getPointerOperand())));
+        unsigned py = getPointee(getNode(y));
+        join(px, py);
+    }
+
+    void handleCallInst(CallInst* callinst){
+        Value* callop = callinst->getCalledOperand()->stripPointerCasts();
+        if(isObject(callinst)){
+            unsigned x = getNode(callinst);
+            // realloc and the like: *x = *arg
+            if(callinst->arg_size() && callinst->getArgOperand(0)->getType()->isPointerTy()){
+                unsigned px = getPointee(getPointee(x));
+                join(px, getPointee(getPointee(getNode(callinst->getArgOperand(0)))));
+            }
+            return ;
+        }
+        if(Function* f = dyn_cast<Function>(callop)){
+            bindCall(callinst, f);
+            return ;
+        }
+        indirectCalls.push_back(callinst);
+    }
+
+    /// Unify the arguments and return value of @callinst with those of
+    /// callee @f. Intrinsics are no callees.
+    void bindCall(CallInst* callinst, Function* f){
+        if(f->isIntrinsic() || !bound.insert({callinst, f}).second) return ;
+        callees[callinst].set(objIndex.getID(f));
+        if(f->isDeclaration()) return ;
+
+        for(unsigned i=0;i<callinst->arg_size() && i<f->arg_size();i++){
+            Value* argi = callinst->getArgOperand(i);
+            if(argi->getType()->isPointerTy()) assign(f->getArg(i), argi);
+        }
+        if(callinst->getType()->isPointerTy()){
+            join(getPointee(getNode(callinst)), getPointee(getRetNode(f)));
+        }
+    }
+
+    void handleInitializer(GlobalVariable* gv, Constant* init){
+        if(init->getType()->isPointerTy()){
+            if(isa<ConstantPointerNull>(init) || isa<UndefValue>(init)) return ;
+            unsigned px = getPointee(getPointee(getNode(gv)));
+            join(px, getPointee(getNode(init)));
+            return ;
+        }
+        for(Value* op : init->operands()){
+            if(Constant* c = dyn_cast<Constant>(op)) handleInitializer(gv, c);
+        }
+    }
+
+public:
+    void solve(Module &M){
+        StatsPhase phase(AnalysisStats::Unification);
+        for(GlobalVariable &gv : M.globals()){
+            if(gv.hasInitializer()) handleInitializer(&gv, gv.getInitializer());
+        }
+        for(Function &fn : M){
+            for(inst_iterator ii = inst_begin(fn), ie = inst_end(fn); ii != ie; ++ii){
+                Instruction* inst = &*ii;
+                if(isa<DbgInfoIntrinsic>(inst)) continue;
+
+                if(LoadInst* loadinst = dyn_cast<LoadInst>(inst))
+                    handleLoadInst(loadinst);
+                else if(StoreInst* storeinst = dyn_cast<StoreInst>(inst))
+                    handleStoreInst(storeinst);
+                else if(CallInst* callinst = dyn_cast<CallInst>(inst))
+                    handleCallInst(callinst);
+                else if(ReturnInst* retinst = dyn_cast<ReturnInst>(inst)){
+                    Value* retval = retinst->getReturnValue();
+                    if(retval && retval->getType()->isPointerTy())
+                        join(getPointee(getRetNode(&fn)), getPointee(getNode(retval)));
+                }
+                else if(isa<GetElementPtrInst>(inst) || isa<CastInst>(inst) ||
+                        isa<PHINode>(inst) || isa<SelectInst>(inst)){
+                    if(!inst->getType()->isPointerTy()) continue;
+                    for(Value* op : inst->operands()){
+                        if(op->getType()->isPointerTy()) assign(inst, op);
+                    }
+                }
+            }
+        }
+
+        // binding a target may unify more classes, so go until nothing new
+        bool changed = true;
+        while(changed){
+            changed = false;
+            for(CallInst* callinst : indirectCalls){
+                PtsSet targets = objs[getPointee(getNode(callinst->getCalledOperand()))];
+                for(unsigned obj : targets){
+                    Function* f = dyn_cast<Function>(objIndex.getObject(obj));
+                    if(!f || bound.count({callinst, f})) continue;
+                    bindCall(callinst, f);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    /// Class of the memory @ptr may point to. Every node @ptr may point
+    /// to, its fields and the target of a pointer it derives from have
+    /// their storage there, so accesses through pointers in different
+    /// classes never touch the same node.
+    unsigned getPartition(Value* ptr){
+        return getPointee(getNode(ptr));
+    }
+
+    /// Functions @callinst may call, as object ids. Looking a call up
+    /// adds nothing to the table, so the set stays valid until the next
+    /// solve.
+    const PtsSet& getCallees(CallInst* callinst) const {
+        static const PtsSet empty;
+        auto found = callees.find(callinst);
+        return found == callees.end() ? empty : found->second;
+    }
+
+    bool mayCall(CallInst* callinst, Function* f) const {
+        return getCallees(callinst).test(objIndex.getID(f));
+    }
+
+    /// Functions reachable from @root through resolved calls
+    void compReachable(Function* root){
+        std::vector<Function*> pending{root};
+        reachable.insert(root);
+        while(!pending.empty()){
+            Function* fn = pending.back();
+            pending.pop_back();
+            for(inst_iterator ii = inst_begin(*fn), ie = inst_end(*fn); ii != ie; ++ii){
+                CallInst* callinst = dyn_cast<CallInst>(&*ii);
+                if(!callinst) continue;
+                for(unsigned obj : getCallees(callinst)){
+                    Function* f = cast<Function>(objIndex.getObject(obj));
+                    if(reachable.insert(f).second) pending.push_back(f);
+                }
+            }
+        }
+    }
+
+    bool isReachable(Function* f) const {
+        return reachable.count(f);
+    }
+};
+
+#endif /* !_STEENSGAARD_H_ */
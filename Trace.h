@@ -0,0 +1,243 @@
+/************************************************************************
+ *
+ * @file Trace.h
+ *
+ * Timeline of solver activity in the Chrome trace-event format
+ *
+ ***********************************************************************/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using namespace llvm;
+
+/// Whether -trace-events was given. Every hook tests this first, so a run
+/// without it reads no clocks and formats nothing.
+bool traceEnabled = false;
+
+static cl::opt<std::string> TraceFile("trace-events",
+    cl::desc("Write a timeline of block visits and call target discoveries to this file, "
+             "for chrome://tracing or ui.perfetto.dev"),
+    cl::value_desc("file"), cl::init(""),
+    cl::callback([](const std::string &path){ traceEnabled = !path.empty(); }));
+
+static cl::opt<unsigned> TraceLimit("trace-limit",
+    cl::desc("Stop recording -trace-events after this many events"),
+    cl::init(2000000));
+
+///
+/// Events recorded by one thread, as comma separated JSON objects. They
+/// are appended to the file in chunks, so threads only ever contend for
+/// the file, not for every event.
+///
+struct TraceBuffer {
+    std::string events;
+    unsigned tid = 0;                          /// 0 until the thread records its first event
+    DenseMap<const void*, unsigned> visits;     /// times each block was visited
+    DenseMap<const void*, std::string> labels;  /// names given to blocks on the timeline
+};
+
+thread_local TraceBuffer traceBuffer;
+
+std::mutex traceLock;                      /// guards everything below
+std::unique_ptr<raw_fd_ostream> traceOut;
+bool traceStarted = false;                 /// the first chunk has been written
+unsigned traceThreads = 0;
+std::atomic<uint64_t> traceEvents(0);
+std::atomic<uint64_t> traceDropped(0);
+
+const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+/// Microseconds since the start of the run
+double traceNow(){
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+/// Append the events of this thread to -trace-events
+void writeTraceChunk(){
+    if(traceBuffer.events.empty()) return;
+    std::lock_guard<std::mutex> guard(traceLock);
+    if(!traceOut){
+        std::error_code ec;
+        traceOut = std::make_unique<raw_fd_ostream>(TraceFile, ec, sys::fs::OF_Text);
+        if(ec){
+            errs() << "warning: could not write trace " << TraceFile << ": " << ec.message() << "\n";
+            traceEnabled = false;
+            traceOut.reset();
+            traceBuffer.events.clear();
+            return ;
+        }
+        *traceOut << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    }
+    if(traceStarted) *traceOut << ",\n";
+    *traceOut << traceBuffer.events;
+    traceStarted = true;
+    traceBuffer.events.clear();
+}
+
+///
+/// Record one event of phase @ph ('X' complete, 'i' instant, 'C' counter,
+/// 'M' metadata). @args writes the members of its "args" object.
+///
+void traceEvent(char ph, StringRef cat, StringRef name, double ts, double dur,
+                function_ref<void(json::OStream&)> args){
+    if(traceEvents++ >= TraceLimit){
+        traceDropped++;
+        return ;
+    }
+
+    TraceBuffer &buf = traceBuffer;
+    if(!buf.tid){
+        {
+            std::lock_guard<std::mutex> guard(traceLock);
+            buf.tid = ++traceThreads;
+        }
+        traceEvent('M', "", "thread_name", 0, 0, [&](json::OStream &out){
+            out.attribute("name", ("solver " + Twine(buf.tid)).str());
+        });
+    }
+
+    if(!buf.events.empty()) buf.events += ",\n";
+    raw_string_ostream os(buf.events);
+    json::OStream out(os);
+    out.object([&]{
+        out.attribute("name", name);
+        if(!cat.empty()) out.attribute("cat", cat);
+        out.attribute("ph", StringRef(&ph, 1));
+        out.attribute("pid", 1);
+        out.attribute("tid", (int64_t)buf.tid);
+        out.attribute("ts", ts);
+        if(ph == 'X') out.attribute("dur", dur);
+        if(ph == 'i') out.attribute("s", "t");
+        out.attributeObject("args", [&]{ args(out); });
+    });
+    os.flush();
+
+    if(buf.events.size() > (1 << 22)) writeTraceChunk();
+}
+
+/// Write out the events of this thread and forget its blocks, whose
+/// addresses the next module may reuse
+void flushTrace(){
+    writeTraceChunk();
+    traceBuffer.visits.clear();
+    traceBuffer.labels.clear();
+}
+
+///
+/// Gives a job of a thread pool a buffer of its own for the enclosing
+/// scope, on the timeline of the thread running it, and writes its events
+/// out when the job ends. Without it the events of a worker thread would
+/// stay in its buffer, and be lost when the thread exits.
+///
+class TraceJob {
+    TraceBuffer saved;
+    bool on;
+
+public:
+    TraceJob() : on(traceEnabled) {
+        if(!on) return;
+        std::swap(saved, traceBuffer);
+        traceBuffer.tid = saved.tid;
+    }
+
+    ~TraceJob(){
+        if(!on) return;
+        writeTraceChunk();
+        saved.tid = traceBuffer.tid;
+        std::swap(saved, traceBuffer);
+    }
+};
+
+/// Mark that @name happened in @cat just now
+void traceInstant(StringRef cat, const Twine &name, function_ref<void(json::OStream&)> args){
+    if(!traceEnabled) return;
+    traceEvent('i', cat, name.str(), traceNow(), 0, args);
+}
+
+/// Plot @value as the current level of the counter @name
+void traceCounter(StringRef name, int64_t value){
+    if(!traceEnabled) return;
+    traceEvent('C', "", name, traceNow(), 0, [&](json::OStream &out){
+        out.attribute("value", value);
+    });
+}
+
+/// The number of this visit of @block, starting from 1
+unsigned traceVisit(const void* block){
+    return ++traceBuffer.visits[block];
+}
+
+///
+/// Records the enclosing scope as one slice of the timeline, if
+/// -trace-events is on. The name and the arguments are only set, and
+/// should only be computed, once enabled() says so.
+///
+class TraceSpan {
+    const char* cat;
+    std::string name;
+    json::Object args;
+    double start = 0;
+    bool on;
+
+public:
+    explicit TraceSpan(const char* c) : cat(c), on(traceEnabled) {
+        if(on) start = traceNow();
+    }
+
+    TraceSpan(const char* c, const Twine &n) : TraceSpan(c) {
+        if(on) name = n.str();
+    }
+
+    ~TraceSpan(){
+        if(!on) return;
+        double end = traceNow();
+        traceEvent('X', cat, name, start, end - start, [&](json::OStream &out){
+            for(auto &arg : args) out.attribute(arg.first, arg.second);
+        });
+    }
+
+    bool enabled() const {
+        return on;
+    }
+
+    void setName(const Twine &n){
+        name = n.str();
+    }
+
+    void arg(StringRef key, json::Value value){
+        args[key] = std::move(value);
+    }
+};
+
+/// Flush this thread and finish the -trace-events file, if given
+bool writeTrace(){
+    if(TraceFile.empty()) return true;
+    writeTraceChunk();
+
+    std::lock_guard<std::mutex> guard(traceLock);
+    if(!traceOut) return false;
+    *traceOut << "\n],\"otherData\":{\"events\":" << (traceEvents - traceDropped)
+              << ",\"dropped\":" << traceDropped << "}}\n";
+    traceOut->close();
+    bool ok = !traceOut->has_error();
+    traceOut.reset();
+    return ok;
+}
+
+#endif /* !_TRACE_H_ */
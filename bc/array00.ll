@@ -0,0 +1,51 @@
+; Arrays: every element of an array falls on the array's one node, so a
+; store to an element adds to it and never overwrites the others. The
+; calls through arr[i], arr[0] and a pointer stepping over the elements
+; all see both callees.
+;   10:minus,plus  11:minus,plus  12:minus,plus
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @plus(i32 %a, i32 %b) !dbg !13 {
+  %add = add i32 %a, %b
+  ret i32 %add
+}
+
+define i32 @minus(i32 %a, i32 %b) !dbg !14 {
+  %sub = sub i32 %a, %b
+  ret i32 %sub
+}
+
+define void @moo(i64 %i) !dbg !31 {
+entry:
+  %arr = alloca [2 x i32 (i32, i32)*]
+  %a0 = getelementptr [2 x i32 (i32, i32)*], [2 x i32 (i32, i32)*]* %arr, i64 0, i64 0
+  %a1 = getelementptr [2 x i32 (i32, i32)*], [2 x i32 (i32, i32)*]* %arr, i64 0, i64 1
+  store i32 (i32, i32)* @plus, i32 (i32, i32)** %a0
+  store i32 (i32, i32)* @minus, i32 (i32, i32)** %a1
+  %ai = getelementptr [2 x i32 (i32, i32)*], [2 x i32 (i32, i32)*]* %arr, i64 0, i64 %i
+  %f = load i32 (i32, i32)*, i32 (i32, i32)** %ai
+  %c1 = call i32 %f(i32 1, i32 2), !dbg !40
+  %g = load i32 (i32, i32)*, i32 (i32, i32)** %a0
+  %c2 = call i32 %g(i32 1, i32 2), !dbg !41
+  %next = getelementptr i32 (i32, i32)*, i32 (i32, i32)** %a0, i64 1
+  %h = load i32 (i32, i32)*, i32 (i32, i32)** %next
+  %c3 = call i32 %h(i32 1, i32 2), !dbg !42
+  ret void
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!9, !10}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "hand", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "array00.c", directory: "/tmp")
+!2 = !{}
+!6 = !DISubroutineType(types: !2)
+!9 = !{i32 7, !"Dwarf Version", i32 4}
+!10 = !{i32 2, !"Debug Info Version", i32 3}
+!13 = distinct !DISubprogram(name: "plus", scope: !1, file: !1, line: 1, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!14 = distinct !DISubprogram(name: "minus", scope: !1, file: !1, line: 2, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!31 = distinct !DISubprogram(name: "moo", scope: !1, file: !1, line: 9, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!40 = !DILocation(line: 10, scope: !31)
+!41 = !DILocation(line: 11, scope: !31)
+!42 = !DILocation(line: 12, scope: !31)
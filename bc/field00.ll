@@ -0,0 +1,88 @@
+; Struct fields: every field keeps its own callees, whether it is reached
+; through a nested GEP, a callee, a byte offset on a cast pointer or a phi.
+; What a callee stores adds to a field, so line 13 keeps times.
+;   10:plus  11:times  12:setsecond  13:minus,times  14:plus
+;   15:minus,plus,times
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+%pair = type { i32 (i32, i32)*, i32 (i32, i32)* }
+%outer = type { i32, %pair }
+
+define i32 @plus(i32 %a, i32 %b) !dbg !13 {
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+define i32 @minus(i32 %a, i32 %b) !dbg !14 {
+  %r = sub i32 %a, %b
+  ret i32 %r
+}
+
+define i32 @times(i32 %a, i32 %b) !dbg !15 {
+  %r = mul i32 %a, %b
+  ret i32 %r
+}
+
+define void @setsecond(%pair* %p) !dbg !16 {
+  %second = getelementptr %pair, %pair* %p, i32 0, i32 1
+  store i32 (i32, i32)* @minus, i32 (i32, i32)** %second
+  ret void
+}
+
+define void @moo(i32 %x) !dbg !31 {
+entry:
+  %o = alloca %outer
+  %first = getelementptr %outer, %outer* %o, i32 0, i32 1, i32 0
+  %second = getelementptr %outer, %outer* %o, i32 0, i32 1, i32 1
+  store i32 (i32, i32)* @plus, i32 (i32, i32)** %first
+  store i32 (i32, i32)* @times, i32 (i32, i32)** %second
+  %f = load i32 (i32, i32)*, i32 (i32, i32)** %first
+  %c1 = call i32 %f(i32 1, i32 2), !dbg !40
+  %g = load i32 (i32, i32)*, i32 (i32, i32)** %second
+  %c2 = call i32 %g(i32 1, i32 2), !dbg !41
+  %inner = getelementptr %outer, %outer* %o, i32 0, i32 1
+  call void @setsecond(%pair* %inner), !dbg !42
+  %h = load i32 (i32, i32)*, i32 (i32, i32)** %second
+  %c3 = call i32 %h(i32 1, i32 2), !dbg !43
+  %raw = bitcast %outer* %o to i8*
+  %at8 = getelementptr i8, i8* %raw, i64 8
+  %cast = bitcast i8* %at8 to i32 (i32, i32)**
+  %k = load i32 (i32, i32)*, i32 (i32, i32)** %cast
+  %c4 = call i32 %k(i32 1, i32 2), !dbg !44
+  %cmp = icmp sgt i32 %x, 0
+  br i1 %cmp, label %left, label %right
+
+left:
+  br label %join
+
+right:
+  br label %join
+
+join:
+  %either = phi i32 (i32, i32)** [ %first, %left ], [ %second, %right ]
+  %m = load i32 (i32, i32)*, i32 (i32, i32)** %either
+  %c5 = call i32 %m(i32 1, i32 2), !dbg !45
+  ret void
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!9, !10}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "hand", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "field00.c", directory: "/tmp")
+!2 = !{}
+!6 = !DISubroutineType(types: !2)
+!9 = !{i32 7, !"Dwarf Version", i32 4}
+!10 = !{i32 2, !"Debug Info Version", i32 3}
+!13 = distinct !DISubprogram(name: "plus", scope: !1, file: !1, line: 1, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!14 = distinct !DISubprogram(name: "minus", scope: !1, file: !1, line: 2, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!15 = distinct !DISubprogram(name: "times", scope: !1, file: !1, line: 3, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!16 = distinct !DISubprogram(name: "setsecond", scope: !1, file: !1, line: 4, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!31 = distinct !DISubprogram(name: "moo", scope: !1, file: !1, line: 9, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!40 = !DILocation(line: 10, scope: !31)
+!41 = !DILocation(line: 11, scope: !31)
+!42 = !DILocation(line: 12, scope: !31)
+!43 = !DILocation(line: 13, scope: !31)
+!44 = !DILocation(line: 14, scope: !31)
+!45 = !DILocation(line: 15, scope: !31)
@@ -0,0 +1,81 @@
+; Heap objects: every allocation site is one object, realloc moves the
+; contents of the old one, and a callee's site is shared by its callers.
+; The two xalloc objects are one node that stands for both, so the store
+; of minus does not overwrite plus.
+;   10:malloc  11:calloc  12:set  13:realloc  14:plus  15:minus
+;   16:xalloc  17:xalloc  18:minus,plus
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @plus(i32 %a, i32 %b) !dbg !13 {
+  %add = add i32 %a, %b
+  ret i32 %add
+}
+
+define i32 @minus(i32 %a, i32 %b) !dbg !14 {
+  %sub = sub i32 %a, %b
+  ret i32 %sub
+}
+
+define void @set(i32 (i32, i32)** %slot) !dbg !15 {
+  store i32 (i32, i32)* @minus, i32 (i32, i32)** %slot
+  ret void
+}
+
+define i8* @xalloc(i64 %n) !dbg !16 {
+  %m = call i8* @malloc(i64 %n)
+  ret i8* %m
+}
+
+define void @moo(i32 %x) !dbg !31 {
+entry:
+  %p = call i8* @malloc(i64 8), !dbg !40
+  %q = call i8* @calloc(i64 1, i64 8), !dbg !41
+  %pp = bitcast i8* %p to i32 (i32, i32)**
+  %qq = bitcast i8* %q to i32 (i32, i32)**
+  store i32 (i32, i32)* @plus, i32 (i32, i32)** %pp
+  call void @set(i32 (i32, i32)** %qq), !dbg !42
+  %r = call i8* @realloc(i8* %p, i64 16), !dbg !43
+  %rr = bitcast i8* %r to i32 (i32, i32)**
+  %f = load i32 (i32, i32)*, i32 (i32, i32)** %rr
+  %c1 = call i32 %f(i32 1, i32 2), !dbg !44
+  %g = load i32 (i32, i32)*, i32 (i32, i32)** %qq
+  %c2 = call i32 %g(i32 1, i32 2), !dbg !45
+  %s = call i8* @xalloc(i64 8), !dbg !46
+  %ss = bitcast i8* %s to i32 (i32, i32)**
+  %t = call i8* @xalloc(i64 8), !dbg !47
+  %tt = bitcast i8* %t to i32 (i32, i32)**
+  store i32 (i32, i32)* @plus, i32 (i32, i32)** %ss
+  store i32 (i32, i32)* @minus, i32 (i32, i32)** %tt
+  %h = load i32 (i32, i32)*, i32 (i32, i32)** %ss
+  %c3 = call i32 %h(i32 1, i32 2), !dbg !48
+  ret void
+}
+
+declare i8* @malloc(i64)
+declare i8* @calloc(i64, i64)
+declare i8* @realloc(i8*, i64)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!9, !10}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "hand", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "heap00.c", directory: "/tmp")
+!2 = !{}
+!6 = !DISubroutineType(types: !2)
+!9 = !{i32 7, !"Dwarf Version", i32 4}
+!10 = !{i32 2, !"Debug Info Version", i32 3}
+!13 = distinct !DISubprogram(name: "plus", scope: !1, file: !1, line: 1, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!14 = distinct !DISubprogram(name: "minus", scope: !1, file: !1, line: 2, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!15 = distinct !DISubprogram(name: "set", scope: !1, file: !1, line: 3, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!16 = distinct !DISubprogram(name: "xalloc", scope: !1, file: !1, line: 4, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!31 = distinct !DISubprogram(name: "moo", scope: !1, file: !1, line: 9, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!40 = !DILocation(line: 10, scope: !31)
+!41 = !DILocation(line: 11, scope: !31)
+!42 = !DILocation(line: 12, scope: !31)
+!43 = !DILocation(line: 13, scope: !31)
+!44 = !DILocation(line: 14, scope: !31)
+!45 = !DILocation(line: 15, scope: !31)
+!46 = !DILocation(line: 16, scope: !31)
+!47 = !DILocation(line: 17, scope: !31)
+!48 = !DILocation(line: 18, scope: !31)
@@ -0,0 +1,65 @@
+; Heap objects under mutual recursion: moo calls foo, which calls moo
+; again, so each activation of moo allocates an object of its own at
+; line 10. The outer one stores plus, the inner one minus, and the load
+; at line 12 reads both: the site is no single object, its stores are
+; weak.
+;   10:malloc  11:foo  12:minus,plus
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @plus(i32 %a, i32 %b) !dbg !13 {
+  %add = add i32 %a, %b
+  ret i32 %add
+}
+
+define i32 @minus(i32 %a, i32 %b) !dbg !14 {
+  %sub = sub i32 %a, %b
+  ret i32 %sub
+}
+
+define void @foo(i32 %x) !dbg !15 {
+  call void @moo(i32 0), !dbg !20
+  ret void
+}
+
+define void @moo(i32 %x) !dbg !31 {
+entry:
+  %p = call i8* @malloc(i64 8), !dbg !40
+  %pp = bitcast i8* %p to i32 (i32, i32)**
+  %z = icmp eq i32 %x, 0
+  br i1 %z, label %inner, label %outer
+
+inner:
+  store i32 (i32, i32)* @minus, i32 (i32, i32)** %pp
+  br label %done
+
+outer:
+  store i32 (i32, i32)* @plus, i32 (i32, i32)** %pp
+  call void @foo(i32 %x), !dbg !41
+  br label %done
+
+done:
+  %f = load i32 (i32, i32)*, i32 (i32, i32)** %pp
+  %c = call i32 %f(i32 1, i32 2), !dbg !42
+  ret void
+}
+
+declare i8* @malloc(i64)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!9, !10}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "hand", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "heap01.c", directory: "/tmp")
+!2 = !{}
+!6 = !DISubroutineType(types: !2)
+!9 = !{i32 7, !"Dwarf Version", i32 4}
+!10 = !{i32 2, !"Debug Info Version", i32 3}
+!13 = distinct !DISubprogram(name: "plus", scope: !1, file: !1, line: 1, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!14 = distinct !DISubprogram(name: "minus", scope: !1, file: !1, line: 2, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!15 = distinct !DISubprogram(name: "foo", scope: !1, file: !1, line: 3, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!20 = !DILocation(line: 4, scope: !15)
+!31 = distinct !DISubprogram(name: "moo", scope: !1, file: !1, line: 9, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!40 = !DILocation(line: 10, scope: !31)
+!41 = !DILocation(line: 11, scope: !31)
+!42 = !DILocation(line: 12, scope: !31)
@@ -0,0 +1,75 @@
+; Recursion: moo calls itself with its arguments swapped, replaced and
+; fixed, so its body is one cycle whose calls all resolve to moo, and
+; both of its function pointers end up holding every callee.
+;   10:minus,plus,times  11:moo  12:moo  13:moo  14:minus,plus,times
+;   15:moo  16:moo
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@g = global i32 (i32, i32)* null
+
+define i32 @plus(i32 %a, i32 %b) !dbg !13 {
+  %add = add i32 %a, %b
+  ret i32 %add
+}
+
+define i32 @minus(i32 %a, i32 %b) !dbg !14 {
+  %sub = sub i32 %a, %b
+  ret i32 %sub
+}
+
+define i32 @times(i32 %a, i32 %b) !dbg !15 {
+  %m = mul i32 %a, %b
+  ret i32 %m
+}
+
+define void @main() !dbg !16 {
+  call void @moo(i32 3, i32 (i32, i32)* @plus, i32 (i32, i32)* @minus), !dbg !45
+  ret void
+}
+
+define void @moo(i32 %x, i32 (i32, i32)* %a, i32 (i32, i32)* %b) !dbg !31 {
+entry:
+  %c0 = call i32 %a(i32 1, i32 2), !dbg !40
+  store i32 (i32, i32)* %a, i32 (i32, i32)** @g
+  %cmp = icmp sgt i32 %x, 0
+  br i1 %cmp, label %rec, label %out
+
+rec:
+  %y = sub i32 %x, 1
+  call void @moo(i32 %y, i32 (i32, i32)* %b, i32 (i32, i32)* %a), !dbg !41
+  call void @moo(i32 %y, i32 (i32, i32)* %b, i32 (i32, i32)* @times), !dbg !42
+  call void @moo(i32 %y, i32 (i32, i32)* %b, i32 (i32, i32)* %a), !dbg !43
+  call void @moo(i32 %y, i32 (i32, i32)* @plus, i32 (i32, i32)* @minus), !dbg !46
+  call void @moo(i32 %y, i32 (i32, i32)* @minus, i32 (i32, i32)* @plus), !dbg !47
+  br label %out
+
+out:
+  %f = load i32 (i32, i32)*, i32 (i32, i32)** @g
+  %c1 = call i32 %f(i32 1, i32 2), !dbg !44
+  ret void
+}
+
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!9, !10}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "hand", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "rec00.c", directory: "/tmp")
+!2 = !{}
+!6 = !DISubroutineType(types: !2)
+!9 = !{i32 7, !"Dwarf Version", i32 4}
+!10 = !{i32 2, !"Debug Info Version", i32 3}
+!13 = distinct !DISubprogram(name: "plus", scope: !1, file: !1, line: 1, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!14 = distinct !DISubprogram(name: "minus", scope: !1, file: !1, line: 2, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!15 = distinct !DISubprogram(name: "times", scope: !1, file: !1, line: 3, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!16 = distinct !DISubprogram(name: "main", scope: !1, file: !1, line: 30, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!31 = distinct !DISubprogram(name: "moo", scope: !1, file: !1, line: 9, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!40 = !DILocation(line: 10, scope: !31)
+!41 = !DILocation(line: 11, scope: !31)
+!42 = !DILocation(line: 12, scope: !31)
+!43 = !DILocation(line: 13, scope: !31)
+!44 = !DILocation(line: 14, scope: !31)
+!45 = !DILocation(line: 31, scope: !16)
+!46 = !DILocation(line: 15, scope: !31)
+!47 = !DILocation(line: 16, scope: !31)
@@ -0,0 +1,53 @@
+; Recursion through a local: moo passes its own local to the call of
+; itself, which stores to it, so that effect outlives the inner run even
+; though the local is moo's own. g gets minus only through it.
+;   10:moo  11:minus
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@g = global i32 (i32, i32)* null
+
+define i32 @plus(i32 %a, i32 %b) !dbg !13 {
+  %add = add i32 %a, %b
+  ret i32 %add
+}
+
+define i32 @minus(i32 %a, i32 %b) !dbg !14 {
+  %sub = sub i32 %a, %b
+  ret i32 %sub
+}
+
+define void @moo(i32 (i32, i32)** %p, i64 %n) !dbg !31 {
+entry:
+  %local = alloca i32 (i32, i32)*
+  %z = icmp eq i64 %n, 0
+  br i1 %z, label %base, label %rec
+rec:
+  %m = sub i64 %n, 1
+  call void @moo(i32 (i32, i32)** %local, i64 %m), !dbg !40
+  %l = load i32 (i32, i32)*, i32 (i32, i32)** %local
+  store i32 (i32, i32)* %l, i32 (i32, i32)** @g
+  br label %end
+base:
+  store i32 (i32, i32)* @minus, i32 (i32, i32)** %p
+  br label %end
+end:
+  %h = load i32 (i32, i32)*, i32 (i32, i32)** @g
+  %c1 = call i32 %h(i32 1, i32 2), !dbg !41
+  ret void
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!9, !10}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "hand", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "rec01.c", directory: "/tmp")
+!2 = !{}
+!6 = !DISubroutineType(types: !2)
+!9 = !{i32 7, !"Dwarf Version", i32 4}
+!10 = !{i32 2, !"Debug Info Version", i32 3}
+!13 = distinct !DISubprogram(name: "plus", scope: !1, file: !1, line: 1, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!14 = distinct !DISubprogram(name: "minus", scope: !1, file: !1, line: 2, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!31 = distinct !DISubprogram(name: "moo", scope: !1, file: !1, line: 9, type: !6, spFlags: DISPFlagDefinition, unit: !0)
+!40 = !DILocation(line: 10, scope: !31)
+!41 = !DILocation(line: 11, scope: !31)
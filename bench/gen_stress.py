@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""Generate a synthetic stress module for the points-to analysis.
+
+The module has NFUNCS leaf functions, NSLOTS global function-pointer slots
+and a root function `moo` made of NBLOCKS blocks. Every block stores a leaf
+into one slot, loads another slot and calls through it, and every
+--loop-every'th block (3 by default, 0 for none) has a back edge, so the
+solver has to iterate to a fixed point.
+
+Optional shapes on top of that:
+  --depth D   nest D structs in moo, like test10.c; every block also stores
+              a leaf through the whole chain of struct pointers and calls
+              back through it
+  --chain C   C setter functions calling each other in a chain, each one
+              storing a leaf into a slot; every fourth block of moo calls
+              the head of the chain
+
+usage: gen_stress.py NFUNCS NSLOTS NBLOCKS [--depth D] [--chain C]
+                     [--loop-every K] > stress.ll
+"""
+import argparse
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a synthetic stress module.")
+    parser.add_argument("nfuncs", type=int)
+    parser.add_argument("nslots", type=int)
+    parser.add_argument("nblocks", type=int)
+    parser.add_argument("--depth", type=int, default=0)
+    parser.add_argument("--chain", type=int, default=0)
+    parser.add_argument("--loop-every", type=int, default=3)
+    args = parser.parse_args()
+    nfuncs, nslots, nblocks = args.nfuncs, args.nslots, args.nblocks
+    depth, chain, loop = args.depth, args.chain, args.loop_every
+
+    out = []
+    md = []
+    # !0 cu, !1 file, !2 empty, !3 subroutine type, !4 moo
+    def node(text):
+        md.append(text)
+        return len(md) - 1 + 5
+
+    def loc(line):
+        return node("!DILocation(line: %d, column: 3, scope: !4)" % line)
+
+    fty = "i32 (i32)*"
+    if depth:
+        out.append("%%s0 = type { %s }" % fty)
+        for k in range(1, depth + 1):
+            out.append("%%s%d = type { %%s%d* }" % (k, k - 1))
+        out.append("")
+    for k in range(nslots):
+        out.append("@slot%d = global %s null" % (k, fty))
+    out.append("")
+    for j in range(nfuncs):
+        out.append("define i32 @leaf%d(i32 %%x) {" % j)
+        out.append("entry:")
+        out.append("  %%r = add i32 %%x, %d" % j)
+        out.append("  ret i32 %r")
+        out.append("}")
+        out.append("")
+    for k in range(chain):
+        out.append("define void @chain%d() {" % k)
+        out.append("entry:")
+        out.append("  store %s @leaf%d, %s* @slot%d" % (fty, (k * 11) % nfuncs, fty, k % nslots))
+        if k + 1 < chain:
+            out.append("  call void @chain%d()" % (k + 1))
+        out.append("  ret void")
+        out.append("}")
+        out.append("")
+
+    out.append("define i32 @moo(i32 %n) !dbg !4 {")
+    out.append("entry:")
+    for k in range(depth + 1 if depth else 0):
+        out.append("  %%a%d = alloca %%s%d" % (k, k))
+    for k in range(1, depth + 1):
+        out.append("  %%e%d = getelementptr %%s%d, %%s%d* %%a%d, i32 0, i32 0" % (k, k, k, k))
+        out.append("  store %%s%d* %%a%d, %%s%d** %%e%d" % (k - 1, k - 1, k - 1, k))
+    out.append("  br label %b0")
+    for i in range(nblocks):
+        line = 10 + i
+        out.append("b%d:" % i)
+        out.append("  store %s @leaf%d, %s* @slot%d" % (fty, (i * 7) % nfuncs, fty, i % nslots))
+        out.append("  %%p%d = load %s, %s* @slot%d" % (i, fty, fty, (i * 3 + 1) % nslots))
+        out.append("  %%c%d = call i32 %%p%d(i32 %%n), !dbg !%d" % (i, i, loc(line)))
+        if depth:
+            ptr = "%%a%d" % depth
+            for k in range(depth, 0, -1):
+                out.append("  %%g%d_%d = getelementptr %%s%d, %%s%d* %s, i32 0, i32 0" % (i, k, k, k, ptr))
+                out.append("  %%l%d_%d = load %%s%d*, %%s%d** %%g%d_%d" % (i, k, k - 1, k - 1, i, k))
+                ptr = "%%l%d_%d" % (i, k)
+            out.append("  %%f%d = getelementptr %%s0, %%s0* %s, i32 0, i32 0" % (i, ptr))
+            out.append("  store %s @leaf%d, %s* %%f%d" % (fty, (i * 5 + 3) % nfuncs, fty, i))
+            out.append("  %%q%d = load %s, %s* %%f%d" % (i, fty, fty, i))
+            out.append("  %%d%d = call i32 %%q%d(i32 %%n), !dbg !%d" % (i, i, loc(10 + nblocks + i)))
+        if chain and i % 4 == 1:
+            out.append("  call void @chain0(), !dbg !%d" % loc(10 + 2 * nblocks + i))
+        nxt = "b%d" % (i + 1) if i + 1 < nblocks else "exit"
+        if loop and i % loop == loop - 1:
+            out.append("  %%t%d = icmp slt i32 %%c%d, %d" % (i, i, i))
+            out.append("  br i1 %%t%d, label %%b%d, label %%%s" % (i, max(0, i - loop), nxt))
+        else:
+            out.append("  br label %%%s" % nxt)
+    out.append("exit:")
+    out.append("  ret i32 0")
+    out.append("}")
+    out.append("")
+
+    out.append("!llvm.dbg.cu = !{!0}")
+    out.append("!llvm.module.flags = !{!%d}" % node('!{i32 2, !"Debug Info Version", i32 3}'))
+    out.append('!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "gen_stress", isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)')
+    out.append('!1 = !DIFile(filename: "stress.c", directory: ".")')
+    out.append("!2 = !{}")
+    out.append("!3 = !DISubroutineType(types: !2)")
+    out.append("!4 = distinct !DISubprogram(name: \"moo\", scope: !1, file: !1, line: 1, type: !3, scopeLine: 1, spFlags: DISPFlagDefinition, unit: !0, retainedNodes: !2)")
+    for i, text in enumerate(md):
+        out.append("!%d = %s" % (i + 5, text))
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""Benchmark every solver on the bc/ corpus and on generated stress modules.
+
+For each module and solver this reports the wall time (best of --repeat
+runs), the blocks visited and visits per block, the peak RSS and the size
+of the reported call target sets. The corpus is analyzed in one -batch
+run. With --json the numbers are saved; with --baseline they are compared
+against a saved run, and the script exits 1 if any of them got worse by
+more than --tolerance, or if any reported set grew.
+
+With --threads every run gets -threads=N, so that runs with different
+thread counts can be compared through --json and --baseline.
+
+usage: run_bench.py --tool build/assignment3 [--sizes 50 200 800]
+                    [--threads N] [--json out.json] [--baseline old.json]
+"""
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+SOLVERS = {
+    "flow": [],
+    "sparse": ["-sparse"],
+    "andersen": ["-engine=andersen"],
+    "steensgaard": ["-engine=steensgaard"],
+}
+
+# name -> generator arguments for size n
+SHAPES = {
+    "flat": lambda n: [n, n // 4 + 1, n],
+    "nested": lambda n: [n // 2 + 1, n // 8 + 1, n, "--depth", 4],
+    "chain": lambda n: [n, n // 4 + 1, n, "--chain", n // 10 + 1],
+    "loopy": lambda n: [n, n // 4 + 1, n, "--loop-every", 2],
+}
+
+
+def count_blocks(ll):
+    """Basic blocks of all function bodies in the textual IR @ll."""
+    blocks = 0
+    body = None
+    for line in ll.splitlines():
+        if line.startswith("define "):
+            body = []
+        elif body is not None:
+            if line.startswith("}"):
+                # the entry block only has a label if the printer gave one
+                first = next((l for l in body if l.strip()), "")
+                blocks += sum(1 for l in body if re.match(r"^[\w.$-]+:", l))
+                if not re.match(r"^[\w.$-]+:", first):
+                    blocks += 1
+                body = None
+            else:
+                body.append(line)
+    return blocks
+
+
+def run(cmd):
+    """Run @cmd, returning (seconds, peak RSS in KB, stderr)."""
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    err = proc.stderr.read().decode()
+    _, status, usage = os.wait4(proc.pid, 0)
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    if proc.returncode != 0:
+        sys.exit("%s failed:\n%s" % (" ".join(cmd), err))
+    return time.time() - start, usage.ru_maxrss, err
+
+
+def measure(tool, flags, inputs, blocks, repeat):
+    best = None
+    for _ in range(repeat):
+        seconds, rss, err = run([tool, "-show-visits"] + flags + inputs)
+        if best is None or seconds < best[0]:
+            best = (seconds, rss, err)
+    seconds, rss, err = best
+
+    visits = sum(int(m) for m in re.findall(r"^visits: (\d+)", err, re.M))
+    targets = [len(m.split(",")) if m else 0
+               for m in re.findall(r"^\d+:(.*)$", err, re.M)]
+    return {
+        "time": round(seconds, 4),
+        "rss_kb": rss,
+        "visits": visits,
+        "visits_per_block": round(visits / blocks, 2) if blocks else 0,
+        "calls": len(targets),
+        "targets": sum(targets),
+        "max_targets": max(targets, default=0),
+    }
+
+
+def compare(results, baseline, tolerance, min_time):
+    """Regressions of @results against @baseline, as printable lines."""
+    old = {(r["module"], r["solver"]): r for r in baseline}
+    problems = []
+    for r in results:
+        o = old.get((r["module"], r["solver"]))
+        if not o:
+            continue
+        where = "%s/%s" % (r["module"], r["solver"])
+        if r["time"] > o["time"] * (1 + tolerance) and r["time"] - o["time"] > min_time:
+            problems.append("%s: time %.3fs -> %.3fs" % (where, o["time"], r["time"]))
+        for key in ("rss_kb", "visits"):
+            if r[key] > o[key] * (1 + tolerance):
+                problems.append("%s: %s %d -> %d" % (where, key, o[key], r[key]))
+        if r["targets"] > o["targets"]:
+            problems.append("%s: reported targets %d -> %d" % (where, o["targets"], r["targets"]))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the points-to solvers.")
+    parser.add_argument("--tool", required=True, help="path to assignment3")
+    parser.add_argument("--llvm-as", default="llvm-as")
+    parser.add_argument("--corpus", default=os.path.join(HERE, "..", "bc"))
+    parser.add_argument("--sizes", type=int, nargs="+", default=[50, 200, 800])
+    parser.add_argument("--shapes", nargs="+", default=list(SHAPES), choices=list(SHAPES))
+    parser.add_argument("--solvers", nargs="+", default=list(SOLVERS), choices=list(SOLVERS))
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--threads", type=int, help="pass -threads=N to every run")
+    parser.add_argument("--json", help="save the results here")
+    parser.add_argument("--baseline", help="compare against results saved with --json")
+    parser.add_argument("--tolerance", type=float, default=0.25)
+    parser.add_argument("--min-time", type=float, default=0.05,
+                        help="ignore slowdowns smaller than this many seconds")
+    args = parser.parse_args()
+
+    modules = []
+    corpus = sorted(os.path.join(args.corpus, f) for f in os.listdir(args.corpus) if f.endswith(".bc"))
+    if corpus:
+        blocks = 0
+        for bc in corpus:
+            ll = bc[:-3] + ".ll"
+            if os.path.exists(ll):
+                with open(ll) as f:
+                    blocks += count_blocks(f.read())
+        modules.append(("corpus", ["-batch", "-jobs=1"] + corpus, blocks))
+
+    tmp = tempfile.TemporaryDirectory()
+    for shape in args.shapes:
+        for n in args.sizes:
+            name = "%s-%d" % (shape, n)
+            ll = os.path.join(tmp.name, name + ".ll")
+            bc = os.path.join(tmp.name, name + ".bc")
+            gen = [sys.executable, os.path.join(HERE, "gen_stress.py")] + [str(a) for a in SHAPES[shape](n)]
+            with open(ll, "w") as f:
+                subprocess.run(gen, stdout=f, check=True)
+            subprocess.run([args.llvm_as, ll, "-o", bc], check=True)
+            with open(ll) as f:
+                modules.append((name, [bc], count_blocks(f.read())))
+
+    results = []
+    print("%-14s %-12s %9s %9s %10s %8s %7s %8s %6s" %
+          ("module", "solver", "time(s)", "rss(KB)", "visits", "v/block", "calls", "targets", "max"))
+    for name, inputs, blocks in modules:
+        for solver in args.solvers:
+            flags = SOLVERS[solver] + (["-threads=%d" % args.threads] if args.threads else [])
+            r = measure(args.tool, flags, inputs, blocks, args.repeat)
+            r.update(module=name, solver=solver, blocks=blocks)
+            results.append(r)
+            print("%-14s %-12s %9.3f %9d %10d %8.2f %7d %8d %6d" %
+                  (name, solver, r["time"], r["rss_kb"], r["visits"], r["visits_per_block"],
+                   r["calls"], r["targets"], r["max_targets"]))
+            sys.stdout.flush()
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=1)
+    if args.baseline:
+        with open(args.baseline) as f:
+            problems = compare(results, json.load(f), args.tolerance, args.min_time)
+        for p in problems:
+            print("REGRESSION " + p)
+        if problems:
+            sys.exit(1)
+        print("no regressions against " + args.baseline)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Check that a run reusing -cache reports what a fresh run does.
+
+The module is analyzed fresh and with a cache, then again after an edit
+to the root alone, which must solve no callee summary again. Then two
+of its function definitions swap places, which changes the root (the
+last function with a body) but no function body. The cached report of
+the first order must not come back for the second, with or without
+-entry.
+
+usage: run_cache.py --tool build/assignment3 --module bc/test19.ll
+                    [--swap clever moo]
+"""
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+
+def run(tool, flags, module):
+    """Everything @tool prints on @module."""
+    r = subprocess.run([tool] + flags + [module], capture_output=True, text=True)
+    if r.returncode != 0:
+        sys.exit("%s %s failed:\n%s" % (" ".join(flags), module, r.stderr))
+    return r.stderr
+
+
+def report(output):
+    """Reported lines of @output."""
+    return [l for l in output.splitlines() if re.match(r"^\d+:", l)]
+
+
+def solved(output):
+    """Summaries solved in a run that printed @output with -show-visits."""
+    m = re.search(r"^summaries: .* (\d+) solved", output, re.M)
+    return int(m.group(1)) if m else 0
+
+
+def edit_function(text, fn):
+    """@text with a dead local added to the entry of @fn."""
+    m = re.search(r"^define [^\n]*@%s\(.*?\n" % fn, text, re.M)
+    if not m:
+        sys.exit("no definition of %s" % fn)
+    entry = text.index("\n", m.end()) + 1
+    return text[:entry] + "  %edited.local = alloca i8, align 1\n" + text[entry:]
+
+
+def swap_functions(text, a, b):
+    """@text with the definitions of @a and @b in each other's place."""
+    defs = {}
+    for m in re.finditer(r"^define [^\n]*@(\w+)\(.*?^}\n", text, re.M | re.S):
+        defs[m.group(1)] = m
+    if a not in defs or b not in defs:
+        sys.exit("no definition of %s or %s" % (a, b))
+    first, second = sorted((defs[a], defs[b]), key=lambda m: m.start())
+    return (text[:first.start()] + second.group(0) + text[first.end():second.start()] +
+            first.group(0) + text[second.end():])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check cached reports against fresh ones.")
+    parser.add_argument("--tool", required=True, help="path to assignment3")
+    parser.add_argument("--module", required=True, help="textual IR of the module")
+    parser.add_argument("--swap", nargs=2, default=["clever", "moo"], metavar="FN")
+    args = parser.parse_args()
+
+    with open(args.module) as f:
+        text = f.read()
+    failed = False
+    with tempfile.TemporaryDirectory() as tmp:
+        cache = os.path.join(tmp, "cache")
+        swapped = os.path.join(tmp, "swapped.ll")
+        with open(swapped, "w") as f:
+            f.write(swap_functions(text, *args.swap))
+        edited = os.path.join(tmp, "edited.ll")
+        with open(edited, "w") as f:
+            f.write(edit_function(text, args.swap[1]))
+
+        # each run reads the cache the one before it left; the summaries
+        # of callees do not depend on the root
+        runs = [
+            ("original", args.module, [], False),
+            ("original again", args.module, [], False),
+            ("root edited", edited, [], True),
+            ("swapped", swapped, [], False),
+            ("swapped -entry", swapped, ["-entry=" + args.swap[1]], False),
+            ("original -entry", args.module, ["-entry=" + args.swap[0]], False),
+        ]
+        for name, module, flags, reused in runs:
+            fresh = report(run(args.tool, flags, module))
+            output = run(args.tool, flags + ["-cache=" + cache, "-show-visits"], module)
+            cached = report(output)
+            if cached != fresh:
+                failed = True
+                print("%-16s FAILED: fresh %s, with the cache %s" % (name, fresh, cached))
+            elif reused and solved(output):
+                failed = True
+                print("%-16s FAILED: %d summaries solved again" % (name, solved(output)))
+            else:
+                print("%-16s ok (%s)" % (name, " ".join(fresh) or "nothing reported"))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Callee regression harness: check the callees every engine reports on
+the bc/ corpus.
+
+The ground truth is what the sources say. test/<module>.c lists the
+callees of a line in comments like "// 24 : foo, clever"; a handwritten
+bc/<module>.ll lists them as "10:plus  11:times" in its leading comment.
+Every line an engine reports must be listed there: with the same callees
+for the flow-sensitive engines, and with at least those callees for the
+flow-insensitive ones, which may report more.
+
+The sources also list calls outside the root function, which no engine
+resolves, so regress/expected/<engine>.txt pins which lines each engine
+reports, one "<module> <line>:<callees>" line per reported call. Engines
+that must agree with another one, like the flow engine on several
+threads, share its file. The script prints what differs from either and
+exits 1; with --update it rewrites the expected files, but only with
+lines that agree with the sources.
+
+usage: run_regress.py --tool build/assignment3 [--engines flow sparse ...]
+                      [--update]
+"""
+import argparse
+import difflib
+import os
+import re
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# name -> (flags, expected file, whether the engine is exact on a line)
+ENGINES = {
+    "flow": ([], "flow", True),
+    "flow-threads": (["-threads=4"], "flow", True),
+    "sparse": (["-sparse"], "flow", True),
+    "steens-seed": (["-steens-seed"], "flow", True),
+    # one node per object: a store to a field adds to the others
+    "flow-nofields": (["-field-limit=0"], "flow-nofields", False),
+    "andersen": (["-engine=andersen"], "andersen", False),
+    "steensgaard": (["-engine=steensgaard"], "steensgaard", False),
+}
+
+
+def source_callees(sources, bc):
+    """line -> set of callees the sources of @bc list, None if it has none."""
+    name = os.path.splitext(os.path.basename(bc))[0]
+    lines = {}
+    c = os.path.join(sources, name + ".c")
+    if os.path.exists(c):
+        with open(c) as f:
+            for l in f:
+                m = re.match(r"\s*//+\s*(\d+)\s*:\s*(.*)", l)
+                if m:
+                    lines[int(m.group(1))] = {x.strip() for x in m.group(2).split(",") if x.strip()}
+        return lines
+    ll = os.path.splitext(bc)[0] + ".ll"
+    if os.path.exists(ll):
+        with open(ll) as f:
+            for l in f:
+                if not l.startswith(";"):
+                    break
+                for m in re.finditer(r"\b(\d+):([\w.]+(?:,[\w.]+)*)", l):
+                    lines[int(m.group(1))] = set(m.group(2).split(","))
+    return lines or None
+
+
+def report(tool, flags, bc):
+    """Reported lines of @tool on @bc, each prefixed by the module name."""
+    r = subprocess.run([tool] + flags + [bc], capture_output=True, text=True)
+    if r.returncode != 0:
+        sys.exit("%s %s failed:\n%s" % (" ".join(flags), bc, r.stderr))
+    name = os.path.basename(bc)
+    return ["%s %s" % (name, l) for l in r.stderr.splitlines() if re.match(r"^\d+:", l)]
+
+
+def check_sources(got, truth, exact):
+    """Reported lines of @got that disagree with the sources in @truth."""
+    wrong = []
+    for l in got:
+        module, rest = l.split(" ", 1)
+        line, callees = rest.split(":", 1)
+        listed = truth.get(module)
+        if listed is None:
+            continue
+        want = listed.get(int(line))
+        have = set(callees.split(",")) if callees else set()
+        if want is None:
+            wrong.append("%s  (no callees listed in the source)" % l)
+        elif have != want if exact else not want <= have:
+            wrong.append("%s  (source lists %s)" % (l, ",".join(sorted(want))))
+    return wrong
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the reported callees against the sources and saved ones.")
+    parser.add_argument("--tool", required=True, help="path to assignment3")
+    parser.add_argument("--corpus", default=os.path.join(HERE, "..", "bc"))
+    parser.add_argument("--sources", default=os.path.join(HERE, "..", "test"))
+    parser.add_argument("--expected", default=os.path.join(HERE, "expected"))
+    parser.add_argument("--engines", nargs="+", default=list(ENGINES), choices=list(ENGINES))
+    parser.add_argument("--update", action="store_true", help="save the current output as expected")
+    args = parser.parse_args()
+
+    corpus = sorted(os.path.join(args.corpus, f) for f in os.listdir(args.corpus) if f.endswith(".bc"))
+    truth = {os.path.basename(bc): source_callees(args.sources, bc) for bc in corpus}
+    failed = False
+    for engine in args.engines:
+        flags, expected, exact = ENGINES[engine]
+        path = os.path.join(args.expected, expected + ".txt")
+        got = [l for bc in corpus for l in report(args.tool, flags, bc)]
+
+        wrong = check_sources(got, truth, exact)
+        if wrong:
+            failed = True
+            print("%-14s FAILED, %d lines disagree with the sources" % (engine, len(wrong)))
+            sys.stdout.writelines("  " + l + "\n" for l in wrong)
+            continue
+        if args.update:
+            with open(path, "w") as f:
+                f.write("\n".join(got) + "\n")
+            print("%-14s saved %d lines to %s" % (engine, len(got), path))
+            continue
+
+        with open(path) as f:
+            want = f.read().splitlines()
+        if got == want:
+            print("%-14s ok (%d lines)" % (engine, len(got)))
+            continue
+        failed = True
+        print("%-14s FAILED" % engine)
+        sys.stdout.writelines(l + "\n" for l in
+                              difflib.unified_diff(want, got, path, engine, lineterm=""))
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
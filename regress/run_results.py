@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Check that a -results file reads back through ResultStoreReader.
+
+The tool writes the result store of a module and prints it again with
+-read-results, which answers every question through the reader:
+
+- the callees of each reported line must be those of the text report;
+- findBlock must map every instruction of a block back to that block;
+- every object must be found by its name;
+- the --pts query must hold in the exit state of some block.
+
+Then the store is cut short at many sizes. A truncated store must
+either be refused or answer from what is left: every line the reader
+prints is one of the full store, or an empty answer. The reader must
+never crash.
+
+usage: run_results.py --tool build/assignment3 --module bc/test19.bc
+                      [--pts moo%i30 @plus]
+"""
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+# answers a reader gives when the words it needs are gone
+EMPTY = [
+    re.compile(r"^\d+:$"),                       # a line without callees
+    re.compile(r"^block \d+  0\+0$"),            # a block without function or instructions
+    re.compile(r"^  inst \d+ found in block -1$"),
+]
+
+
+def run(args):
+    r = subprocess.run(args, capture_output=True, text=True)
+    if r.returncode < 0:
+        sys.exit("%s crashed with signal %d:\n%s" % (" ".join(args), -r.returncode, r.stderr))
+    return r.returncode, [l for l in r.stderr.splitlines() if not l.startswith("sh: ")]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Read a result store back and check its answers.")
+    parser.add_argument("--tool", required=True, help="path to assignment3")
+    parser.add_argument("--module", required=True)
+    parser.add_argument("--pts", nargs=2, default=["moo%i30", "@plus"], metavar=("OBJECT", "TARGET"))
+    args = parser.parse_args()
+
+    errors = []
+    with tempfile.TemporaryDirectory() as tmp:
+        store = os.path.join(tmp, "results")
+        code, report = run([args.tool, "-results=" + store, args.module])
+        if code != 0:
+            sys.exit("writing %s failed:\n%s" % (store, "\n".join(report)))
+        report = [l for l in report if re.match(r"^\d+:", l)]
+        code, full = run([args.tool, "-read-results", store])
+        if code != 0:
+            sys.exit("reading %s failed:\n%s" % (store, "\n".join(full)))
+
+        lines = [l for l in full if re.match(r"^\d+:", l)]
+        if lines != report:
+            errors.append("callees by line %s, the report has %s" % (lines, report))
+        blocks = [l for l in full if l.startswith("block ")]
+        if not blocks:
+            errors.append("no blocks in the store")
+        errors += ["%s: %s" % (b, l.strip()) for b, l in zip(full, full[1:])
+                   if "found in block" in l or "not found by name" in l]
+        obj, target = args.pts
+        if not any(re.match(r"^  out %s:.* %s( |$)" % (re.escape(obj), re.escape(target)), l) for l in full):
+            errors.append("%s points to %s in no exit state" % (obj, target))
+        print("full store    %d lines, %d blocks%s" % (len(lines), len(blocks), "" if errors else ", ok"))
+
+        with open(store, "rb") as f:
+            data = f.read()
+        known = set(full)
+        sizes = sorted(set(range(0, len(data), max(4, len(data) // 64 // 4 * 4))) | {len(data) - 1, len(data) - 4})
+        refused = 0
+        for size in sizes:
+            cut = os.path.join(tmp, "cut")
+            with open(cut, "wb") as f:
+                f.write(data[:size])
+            code, got = run([args.tool, "-read-results", cut])
+            if code != 0:
+                refused += 1
+                continue
+            for l in got:
+                plain = l.replace(" (not found by name)", "")
+                if plain not in known and not any(p.match(plain) for p in EMPTY):
+                    errors.append("store cut to %d bytes: %s" % (size, l))
+        print("truncated     %d sizes, %d refused, the rest answered from what is left" % (len(sizes), refused))
+
+    for e in errors:
+        print("FAILED: " + e)
+    sys.exit(1 if errors else 0)
+
+
+if __name__ == "__main__":
+    main()